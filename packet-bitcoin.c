@@ -28,13 +28,19 @@
 
 #include "config.h"
 
+#include <math.h>
+
 #include <glib.h>
 
 #include <epan/packet.h>
 #include <epan/prefs.h>
 #include <epan/expert.h>
+#include <epan/tap.h>
+#include <epan/stats_tree.h>
 
 #include "packet-tcp.h"
+#include "packet-frame.h"
+#include "packet-bitcoin.h"
 
 #define BITCOIN_MAIN_MAGIC_NUMBER       0xD9B4BEF9
 #define BITCOIN_TESTNET_MAGIC_NUMBER    0xDAB5BFFA
@@ -51,17 +57,61 @@
  * - Payload length - 4 bytes
  * - Checksum - 4 bytes
  */
-#define BITCOIN_HEADER_LENGTH 4+12+4+4
+#define BITCOIN_HEADER_LENGTH (4+12+4+4)
+
+/*
+ * Records of Bitcoin Core's -capturemessages files (msgs_recv.dat and
+ * msgs_sent.dat) have no magic and no checksum:
+ * - Time - 8 bytes, microseconds since the epoch
+ * - Command - 12 bytes
+ * - Payload length - 4 bytes
+ *
+ * The files don't say which side sent a record and the peer is only in the
+ * directory name, so the wrapping prefixes each record with:
+ * - Peer address - 16 bytes, IPv6 (IPv4 as ::ffff:a.b.c.d)
+ * - Peer port - 2 bytes, big endian
+ * - Direction - 1 byte, 0 received from the peer, 1 sent to it
+ */
+#define BITCOIN_CAPTURE_PEER_LENGTH   (16+2+1)
+#define BITCOIN_CAPTURE_HEADER_LENGTH (8+12+4)
+
+/*
+ * Records of Bitcoin Core's blk?????.dat block files:
+ * - Magic - 4 bytes
+ * - Block length - 4 bytes
+ */
+#define BITCOIN_BLOCK_RECORD_HEADER_LENGTH (4+4)
+
+/*
+ * Default TCP ports: bitcoin main/testnet3/regtest, litecoin main/testnet
+ * and dogecoin main.
+ */
+#define BITCOIN_TCP_PORTS "8333,18333,18444,9333,19335,22556"
+
+/*
+ * Largest payload accepted by default, MAX_PROTOCOL_MESSAGE_LENGTH of
+ * Bitcoin Core; peers disconnect on anything bigger.
+ */
+#define BITCOIN_MAX_PAYLOAD 4000000
 
 void proto_register_bitcoin(void);
 void proto_reg_handoff_bitcoin(void);
 
 static int proto_bitcoin = -1;
+static int bitcoin_eo_tap = -1;
+static int bitcoin_tap = -1;
+static int bitcoin_perf_tap = -1;
 
 static gint hf_bitcoin_magic = -1;
 static gint hf_bitcoin_command = -1;
 static gint hf_bitcoin_length = -1;
 static gint hf_bitcoin_checksum = -1;
+static gint hf_bitcoin_oversized_left = -1;
+static gint hf_bitcoin_capture_peer = -1;
+static gint hf_bitcoin_capture_peer_port = -1;
+static gint hf_bitcoin_capture_direction = -1;
+static gint hf_bitcoin_capture_time = -1;
+static gint hf_bitcoin_state_evicted = -1;
 
 
 
@@ -79,6 +129,8 @@ static gint hf_msg_version_user_agent_length32 = -1;
 static gint hf_msg_version_user_agent_length64 = -1;
 static gint hf_msg_version_user_agent = -1;
 static gint hf_msg_version_start_height = -1;
+static gint hf_msg_version_relay = -1;
+static gint hf_msg_version_negotiated = -1;
 
 /* addr message */
 static gint hf_msg_addr_count8 = -1;
@@ -89,6 +141,31 @@ static gint hf_bitcoin_msg_addr = -1;
 static gint hf_msg_addr_address = -1;
 static gint hf_msg_addr_timestamp = -1;
 
+/* addrv2 message */
+static gint hf_msg_addrv2_count8 = -1;
+static gint hf_msg_addrv2_count16 = -1;
+static gint hf_msg_addrv2_count32 = -1;
+static gint hf_msg_addrv2_count64 = -1;
+static gint hf_bitcoin_msg_addrv2 = -1;
+static gint hf_msg_addrv2_item = -1;
+static gint hf_msg_addrv2_timestamp = -1;
+static gint hf_msg_addrv2_services = -1;
+static gint hf_msg_addrv2_network = -1;
+static gint hf_msg_addrv2_addr_length8 = -1;
+static gint hf_msg_addrv2_addr_length16 = -1;
+static gint hf_msg_addrv2_addr_length32 = -1;
+static gint hf_msg_addrv2_addr_length64 = -1;
+static gint hf_msg_addrv2_address_ipv4 = -1;
+static gint hf_msg_addrv2_address_ipv6 = -1;
+static gint hf_msg_addrv2_address = -1;
+static gint hf_msg_addrv2_port = -1;
+
+/* gossiped address tracking */
+static gint hf_addr_first_frame = -1;
+static gint hf_addr_last_frame = -1;
+static gint hf_addr_peers = -1;
+static gint hf_addr_sightings = -1;
+
 /* inv message */
 static gint hf_msg_inv_count8 = -1;
 static gint hf_msg_inv_count16 = -1;
@@ -97,6 +174,7 @@ static gint hf_msg_inv_count64 = -1;
 static gint hf_bitcoin_msg_inv = -1;
 static gint hf_msg_inv_type = -1;
 static gint hf_msg_inv_hash = -1;
+static gint hf_msg_inv_object_frame = -1;
 
 /* getdata message */
 static gint hf_msg_getdata_count8 = -1;
@@ -106,6 +184,12 @@ static gint hf_msg_getdata_count64 = -1;
 static gint hf_bitcoin_msg_getdata = -1;
 static gint hf_msg_getdata_type = -1;
 static gint hf_msg_getdata_hash = -1;
+static gint hf_msg_getdata_answer_frame = -1;
+static gint hf_msg_getdata_request_frame = -1;
+static gint hf_msg_getdata_response_time = -1;
+static gint hf_msg_getdata_notfound = -1;
+static gint hf_msg_getdata_unanswered = -1;
+static gint hf_msg_getdata_inflight = -1;
 
 /* notfound message */
 static gint hf_msg_notfound_count8 = -1;
@@ -134,6 +218,20 @@ static gint hf_bitcoin_msg_getheaders = -1;
 static gint hf_msg_getheaders_start = -1;
 static gint hf_msg_getheaders_stop = -1;
 
+/* headers message */
+static gint hf_msg_headers_count8 = -1;
+static gint hf_msg_headers_count16 = -1;
+static gint hf_msg_headers_count32 = -1;
+static gint hf_msg_headers_count64 = -1;
+static gint hf_bitcoin_msg_headers = -1;
+static gint hf_msg_headers_header = -1;
+static gint hf_msg_headers_announcement = -1;
+
+/* getblocks/getheaders locator resolved against the header chain */
+static gint hf_msg_locator_fork = -1;
+static gint hf_msg_locator_fork_height = -1;
+static gint hf_msg_locator_fork_frame = -1;
+
 /* tx message */
 static gint hf_msg_tx_in_count8 = -1;
 static gint hf_msg_tx_in_count16 = -1;
@@ -151,6 +249,9 @@ static gint hf_msg_tx_in_prev_outp_hash = -1;
 static gint hf_msg_tx_in_prev_outp_index = -1;
 static gint hf_msg_tx_in_sig_script = -1;
 static gint hf_msg_tx_in_seq = -1;
+static gint hf_msg_tx_in_prev_frame = -1;
+static gint hf_msg_tx_in_prev_value = -1;
+static gint hf_msg_tx_in_prev_script_type = -1;
 static gint hf_msg_tx_out_count8 = -1;
 static gint hf_msg_tx_out_count16 = -1;
 static gint hf_msg_tx_out_count32 = -1;
@@ -162,7 +263,20 @@ static gint hf_msg_tx_out_script16 = -1;
 static gint hf_msg_tx_out_script32 = -1;
 static gint hf_msg_tx_out_script64 = -1;
 static gint hf_msg_tx_out_script = -1;
+static gint hf_msg_tx_out_script_type = -1;
 static gint hf_msg_tx_lock_time = -1;
+static gint hf_msg_tx_flag = -1;
+static gint hf_msg_tx_witness = -1;
+static gint hf_msg_tx_witness_count = -1;
+static gint hf_msg_tx_witness_item = -1;
+static gint hf_msg_tx_wtxid = -1;
+static gint hf_msg_tx_size = -1;
+static gint hf_msg_tx_vsize = -1;
+static gint hf_msg_tx_txid = -1;
+static gint hf_msg_tx_duplicate_of = -1;
+static gint hf_msg_tx_fee = -1;
+static gint hf_msg_tx_feerate = -1;
+static gint hf_msg_tx_package_feerate = -1;
 
 /* block message */
 static gint hf_msg_block_transactions8 = -1;
@@ -176,6 +290,54 @@ static gint hf_msg_block_merkle_root = -1;
 static gint hf_msg_block_time = -1;
 static gint hf_msg_block_bits = -1;
 static gint hf_msg_block_nonce = -1;
+static gint hf_msg_block_hash = -1;
+static gint hf_msg_block_txs_skipped = -1;
+static gint hf_msg_block_height = -1;
+static gint hf_msg_block_prev_frame = -1;
+static gint hf_msg_block_orphan = -1;
+static gint hf_msg_block_stale = -1;
+static gint hf_msg_block_fork = -1;
+static gint hf_msg_block_reorg_depth = -1;
+static gint hf_msg_block_reorg_fork_frame = -1;
+static gint hf_msg_block_prop_announce_frame = -1;
+static gint hf_msg_block_prop_announce_delay = -1;
+static gint hf_msg_block_prop_first_frame = -1;
+static gint hf_msg_block_prop_first_delay = -1;
+static gint hf_msg_block_prop_peers = -1;
+static gint hf_msg_block_prop_spread = -1;
+
+/* cmpctblock message */
+static gint hf_bitcoin_msg_cmpctblock = -1;
+static gint hf_msg_cmpctblock_nonce = -1;
+static gint hf_msg_cmpctblock_shortids8 = -1;
+static gint hf_msg_cmpctblock_shortids16 = -1;
+static gint hf_msg_cmpctblock_shortids32 = -1;
+static gint hf_msg_cmpctblock_shortids64 = -1;
+static gint hf_msg_cmpctblock_shortid_list = -1;
+static gint hf_msg_cmpctblock_prefilled8 = -1;
+static gint hf_msg_cmpctblock_prefilled16 = -1;
+static gint hf_msg_cmpctblock_prefilled32 = -1;
+static gint hf_msg_cmpctblock_prefilled64 = -1;
+static gint hf_msg_cmpctblock_high_bandwidth = -1;
+static gint hf_msg_block_stream_start = -1;
+static gint hf_msg_block_stream_length = -1;
+static gint hf_msg_block_stream_pending = -1;
+static gint hf_msg_block_stream_txs = -1;
+
+/* feefilter */
+static gint hf_bitcoin_msg_feefilter = -1;
+static gint hf_msg_feefilter_feerate = -1;
+
+/* sendcmpct */
+static gint hf_bitcoin_msg_sendcmpct = -1;
+static gint hf_msg_sendcmpct_announce = -1;
+static gint hf_msg_sendcmpct_version = -1;
+
+/* feature negotiation */
+static gint hf_bitcoin_negotiation_order = -1;
+static gint hf_bitcoin_negotiation_after_verack = -1;
+static gint hf_bitcoin_negotiation_sender = -1;
+static gint hf_bitcoin_negotiation_peer = -1;
 
 /* ping */
 static gint hf_bitcoin_msg_ping = -1;
@@ -267,12 +429,32 @@ static gint ett_getdata_list = -1;
 static gint ett_notfound_list = -1;
 static gint ett_getblocks_list = -1;
 static gint ett_getheaders_list = -1;
+static gint ett_headers_list = -1;
 static gint ett_tx_in_list = -1;
 static gint ett_tx_in_outp = -1;
 static gint ett_tx_out_list = -1;
+static gint ett_tx_witness = -1;
+static gint ett_block_stream = -1;
+static gint ett_addrv2 = -1;
 
 static dissector_handle_t bitcoin_handle;
 static gboolean bitcoin_desegment  = TRUE;
+static gboolean bitcoin_stream_blocks = FALSE;
+static gboolean bitcoin_outpoint_index = FALSE;
+static gboolean bitcoin_addr_tracking = FALSE;
+static gboolean bitcoin_track_duplicates = FALSE;
+static gboolean bitcoin_block_header_only = FALSE;
+static gboolean bitcoin_header_chain = FALSE;
+static gboolean bitcoin_block_propagation = FALSE;
+static gboolean bitcoin_track_getdata = FALSE;
+static gboolean bitcoin_object_index = FALSE;
+static gboolean bitcoin_cache_digests = FALSE;
+static guint    bitcoin_getdata_timeout = 60000;  /* ms */
+static guint    bitcoin_max_payload = BITCOIN_MAX_PAYLOAD;
+static guint    bitcoin_outpoint_index_size = 64;  /* MB */
+static guint    bitcoin_state_budget = 64;  /* MB per analysis table */
+static range_t *global_bitcoin_tcp_range = NULL;
+static range_t *bitcoin_tcp_range = NULL;
 
 static const value_string magic_types[] =
 {
@@ -284,11 +466,59 @@ static const value_string magic_types[] =
   { 0xC0C0C0C0, "DOGECOIN" },
   { 0, NULL }
 };
+static const value_string capture_directions[] =
+{
+  { 0, "Received" },
+  { 1, "Sent" },
+  { 0, NULL }
+};
+
+#define INV_MSG_TX     1
+#define INV_MSG_BLOCK  2
+#define INV_MSG_CMPCT_BLOCK 4
+#define INV_MSG_WTX    5
+#define INV_MSG_WITNESS_FLAG 0x40000000
+
 static const value_string inv_types[] =
 {
-  { 0, "ERROR" },
-  { 1, "MSG_TX" },
-  { 2, "MSG_BLOCK" },
+  { 0,          "ERROR" },
+  { 1,          "MSG_TX" },
+  { 2,          "MSG_BLOCK" },
+  { 3,          "MSG_FILTERED_BLOCK" },
+  { 4,          "MSG_CMPCT_BLOCK" },
+  { 5,          "MSG_WTX" },
+  { 0x40000001, "MSG_WITNESS_TX" },
+  { 0x40000002, "MSG_WITNESS_BLOCK" },
+  { 0x40000003, "MSG_FILTERED_WITNESS_BLOCK" },
+  { 0, NULL }
+};
+
+/*
+ * Messages negotiating optional features around the version handshake.
+ * Features are never turned off again, so the frame a side first sent
+ * each one in is all that's needed to know the mode of any later frame.
+ * The exception is high-bandwidth compact block mode, which a peer turns
+ * off with sendcmpct(0) when it picks other high-bandwidth peers; its
+ * transitions are kept separately.
+ */
+#define BITCOIN_FEATURE_VERACK        0
+#define BITCOIN_FEATURE_SENDHEADERS   1
+#define BITCOIN_FEATURE_FEEFILTER     2
+#define BITCOIN_FEATURE_WTXIDRELAY    3
+#define BITCOIN_FEATURE_SENDCMPCT     4
+#define BITCOIN_FEATURE_SENDCMPCT_HB  5  /* sendcmpct asking for high-bandwidth mode */
+#define BITCOIN_FEATURE_SENDADDRV2    6
+#define BITCOIN_FEATURE_COUNT         7
+
+static const value_string bitcoin_features[] =
+{
+  { BITCOIN_FEATURE_VERACK,       "verack" },
+  { BITCOIN_FEATURE_SENDHEADERS,  "sendheaders" },
+  { BITCOIN_FEATURE_FEEFILTER,    "feefilter" },
+  { BITCOIN_FEATURE_WTXIDRELAY,   "wtxidrelay" },
+  { BITCOIN_FEATURE_SENDCMPCT,    "sendcmpct" },
+  { BITCOIN_FEATURE_SENDCMPCT_HB, "sendcmpct (high-bandwidth)" },
+  { BITCOIN_FEATURE_SENDADDRV2,   "sendaddrv2" },
   { 0, NULL }
 };
 
@@ -305,988 +535,5284 @@ static const value_string msg_reject_codes[] =
   { 0, NULL }
 };
 
+/* BIP155 network ids */
+#define ADDRV2_NET_IPV4   1
+#define ADDRV2_NET_IPV6   2
+#define ADDRV2_NET_TORV2  3
+#define ADDRV2_NET_TORV3  4
+#define ADDRV2_NET_I2P    5
+#define ADDRV2_NET_CJDNS  6
 
-static guint
-get_bitcoin_pdu_length(packet_info *pinfo _U_, tvbuff_t *tvb, int offset)
+static const value_string addrv2_networks[] =
 {
-  guint32 length;
-  length = BITCOIN_HEADER_LENGTH;
-
-  /* add payload length */
-  length += tvb_get_letohl(tvb, offset+16);
+  { ADDRV2_NET_IPV4,  "IPv4" },
+  { ADDRV2_NET_IPV6,  "IPv6" },
+  { ADDRV2_NET_TORV2, "Tor v2" },
+  { ADDRV2_NET_TORV3, "Tor v3" },
+  { ADDRV2_NET_I2P,   "I2P" },
+  { ADDRV2_NET_CJDNS, "CJDNS" },
+  { 0, NULL }
+};
 
-  return length;
-}
+#define SCRIPT_TYPE_NONSTANDARD   0
+#define SCRIPT_TYPE_P2PK          1
+#define SCRIPT_TYPE_P2PKH         2
+#define SCRIPT_TYPE_P2SH          3
+#define SCRIPT_TYPE_MULTISIG      4
+#define SCRIPT_TYPE_NULL_DATA     5
+#define SCRIPT_TYPE_P2WPKH        6
+#define SCRIPT_TYPE_P2WSH         7
+#define SCRIPT_TYPE_P2TR          8
+
+static const value_string script_types[] =
+{
+  { SCRIPT_TYPE_NONSTANDARD, "Nonstandard" },
+  { SCRIPT_TYPE_P2PK,        "P2PK" },
+  { SCRIPT_TYPE_P2PKH,       "P2PKH" },
+  { SCRIPT_TYPE_P2SH,        "P2SH" },
+  { SCRIPT_TYPE_MULTISIG,    "Multisig" },
+  { SCRIPT_TYPE_NULL_DATA,   "Null data" },
+  { SCRIPT_TYPE_P2WPKH,      "P2WPKH" },
+  { SCRIPT_TYPE_P2WSH,       "P2WSH" },
+  { SCRIPT_TYPE_P2TR,        "P2TR" },
+  { 0, NULL }
+};
 
-/**
- * Create a services sub-tree for bit-by-bit display
+/*
+ * The bytes of an item split across segments, one piece per segment.  A
+ * piece is never changed once added, so the snapshots of all the frames
+ * an item spans share its chain, each up to its own last piece.
  */
-static proto_tree *
-create_services_tree(tvbuff_t *tvb, proto_item *ti, guint32 offset)
+typedef struct _bitcoin_carry_piece
 {
-  proto_tree *tree;
-  guint64 services;
-
-  tree = proto_item_add_subtree(ti, ett_services);
+  struct _bitcoin_carry_piece *prev;  /* earlier bytes of the item, NULL for its first */
+  guint32  length;
+  guint8  *data;
+} bitcoin_carry_piece_t;
 
-  /* start of services */
-  /* NOTE:
-   *  - 2011-06-05
-   *    Currently the boolean tree only supports a maximum of
-   *    32 bits - so we split services in two
-   */
-  services = tvb_get_letoh64(tvb, offset);
+/*
+ * Per-direction cursor used to dissect block messages segment by segment
+ * instead of reassembling the whole payload first.
+ */
+typedef struct _bitcoin_stream_state
+{
+  guint32  first_frame;   /* frame carrying the block message header */
+  guint32  length;        /* block payload length */
+  guint32  pdu_left;      /* payload bytes still to come, 0 if no block in progress */
+  gboolean have_header;   /* block header and tx count already dissected */
+  guint64  tx_left;       /* transactions not yet dissected */
+  guint32  tx_num;        /* transactions dissected so far */
+  guint64  block_key;     /* first 64 bits of the block hash */
+  guint32  carry_len;     /* bytes of an incomplete item held over */
+  bitcoin_carry_piece_t *carry;  /* its last piece, NULL if none */
+} bitcoin_stream_state_t;
 
-  /* service = NODE_NETWORK */
-  proto_tree_add_boolean(tree, hf_services_network, tvb, offset, 4, (guint32)services);
+/*
+ * Per-direction buffer in which the first pass assembles the held-over
+ * item with each new segment; no snapshot refers to it, so it is reused
+ * for every item and only grows to the largest one split.
+ */
+typedef struct _bitcoin_stream_buffer
+{
+  guint8  *data;
+  guint32  size;
+} bitcoin_stream_buffer_t;
 
-  /* end of services */
+/*
+ * Which optional parts of the version and addr messages a protocol
+ * version has, newest first.  The layout of a connection is looked up
+ * once, when its version messages are seen.
+ */
+typedef struct _bitcoin_version_layout
+{
+  guint32  min_version;
+  gboolean addr_from;     /* version has addr_from, nonce and user agent */
+  gboolean start_height;  /* version has start_height */
+  gboolean relay;         /* version has the relay flag (BIP 37) */
+  gboolean addr_time;     /* addr entries start with a timestamp */
+} bitcoin_version_layout_t;
+
+static const bitcoin_version_layout_t version_layouts[] =
+{
+  { 70001, TRUE,  TRUE,  TRUE,  TRUE  },
+  { 31402, TRUE,  TRUE,  FALSE, TRUE  },
+  {   209, TRUE,  TRUE,  FALSE, FALSE },
+  {   106, TRUE,  FALSE, FALSE, FALSE },
+  {     0, FALSE, FALSE, FALSE, FALSE }
+};
 
-  return tree;
-}
+typedef struct _bitcoin_conv_info
+{
+  address                initiator_addr;
+  guint32                initiator_port;
+  bitcoin_stream_state_t stream[2];
+  bitcoin_stream_buffer_t stream_buffer[2];
+  guint32                oversized_left[2];  /* payload bytes of an oversized message still to discard */
+  guint32                inflight[2];   /* getdata requests of each side not answered yet */
+
+  /* per side, indexed by BITCOIN_FEATURE_* */
+  guint32                feature_frame[2][BITCOIN_FEATURE_COUNT];  /* 0 if not sent yet */
+  guint8                 feature_order[2][BITCOIN_FEATURE_COUNT];
+  guint8                 feature_count[2];
+  guint32                late_features[2];  /* bit mask of the ones sent after verack */
+  guint32               *hb_toggles[2];     /* frames turning high-bandwidth mode on, off, on... */
+  guint                  hb_toggle_count[2];
+  guint                  hb_toggle_size[2];
+
+  guint32                version[2];        /* 0 until the side's version message is seen */
+  const bitcoin_version_layout_t *layout;   /* of the negotiated version, NULL if unknown */
+} bitcoin_conv_info_t;
+
+typedef struct _bitcoin_frame_info
+{
+  gboolean have_stream;
+  bitcoin_stream_state_t stream;  /* stream state at the start of the frame */
+  guint32 oversized_left;         /* oversized payload bytes at the start of the frame */
+  guint64 reorg_hash;             /* block whose arrival switched the best chain */
+  guint32 reorg_depth;            /* blocks disconnected from the old best chain */
+  guint32 reorg_fork_frame;       /* frame of the last block both chains share */
+  gboolean have_inflight;
+  guint32 inflight;               /* getdata requests in flight after the frame */
+  guint32 *evicted;               /* entries dropped per BITCOIN_STATE_*, NULL if none */
+  guint32 evicted_msg;            /* message of the frame that dropped them */
+} bitcoin_frame_info_t;
 
-/**
- * Create a sub-tree and fill it with a net_addr structure
+/*
+ * Capture-wide index of the tx outputs seen so far, so inputs can be
+ * linked to the frame that created the output they spend.
+ *
+ * This is an open addressing table of fixed size entries rather than a
+ * GHashTable, as it needs to hold millions of outputs.  Entries are keyed
+ * by the first 64 bits of the txid, which are unique enough within a
+ * capture.  A zero frame number marks an empty slot.
  */
-static proto_tree *
-create_address_tree(tvbuff_t *tvb, proto_item *ti, guint32 offset)
+typedef struct _bitcoin_outpoint
 {
-  proto_tree *tree;
+  guint64 txid;
+  guint32 vout;
+  guint32 frame;
+  guint64 value;
+  guint8  script_type;
+} bitcoin_outpoint_t;
+
+typedef struct _bitcoin_outpoint_table
+{
+  bitcoin_outpoint_t *slots;
+  guint32             size;     /* number of slots, a power of two */
+  guint32             used;
+} bitcoin_outpoint_table_t;
 
-  tree = proto_item_add_subtree(ti, ett_address);
+static bitcoin_outpoint_table_t outpoint_table;
 
-  /* services */
-  ti = proto_tree_add_item(tree, hf_address_services, tvb, offset, 8, ENC_LITTLE_ENDIAN);
-  create_services_tree(tvb, ti, offset);
-  offset += 8;
+/*
+ * Capture-wide header chain built from block and headers messages.
+ *
+ * Headers live in one dense array and point to their parent through the
+ * first 64 bits of prev_block; an open addressing index of entry numbers
+ * (plus one, so 0 marks an empty slot) finds them by block hash.  That's
+ * about 40 bytes per header, so a mainnet-sized chain fits in well under
+ * 64 MB.  The chain work is kept as a float, which is plenty to tell
+ * competing tips apart.
+ *
+ * Headers whose parent wasn't seen (yet) start a fragment, shared by all
+ * the headers below the same missing parent, and work is counted from
+ * there.  When the missing parent arrives the fragment hangs below it,
+ * offset by its work, so only tips of the same fragment tree, counted
+ * from the same first header, are ever compared.
+ */
+#define BITCOIN_HEIGHT_UNKNOWN   G_MAXUINT32
 
-  /* IPv6 address */
-  proto_tree_add_item(tree, hf_address_address, tvb, offset, 16, ENC_NA);
-  offset += 16;
+#define BITCOIN_CHAIN_MAIN       0x01  /* on the best chain */
+#define BITCOIN_CHAIN_HAS_CHILD  0x02
+#define BITCOIN_CHAIN_FORK       0x04  /* the parent already had another child */
 
-  /* port */
-  proto_tree_add_item(tree, hf_address_port, tvb, offset, 2, ENC_BIG_ENDIAN);
+typedef struct _bitcoin_chain_entry
+{
+  guint64 hash;
+  guint64 prev;
+  gfloat  work;      /* chain work, counted from the first ancestor seen */
+  guint32 height;    /* BITCOIN_HEIGHT_UNKNOWN unless derivable */
+  guint32 frame;     /* first frame the header was seen in */
+  guint32 flags;     /* BITCOIN_CHAIN_* */
+  guint32 fragment;
+} bitcoin_chain_entry_t;
+
+typedef struct _bitcoin_chain_fragment
+{
+  guint32 parent;    /* fragment it hangs below plus one, 0 while its parent header is missing */
+  gfloat  offset;    /* work of that parent header */
+  guint32 best;      /* entry with the most work in it and the fragments below it */
+  gfloat  best_work; /* counted from this fragment */
+} bitcoin_chain_fragment_t;
 
-  return tree;
-}
+typedef struct _bitcoin_chain
+{
+  bitcoin_chain_entry_t *entries;
+  guint32                num_entries;
+  guint32                max_entries;
+  guint32               *index;
+  guint32                index_size;  /* number of slots, a power of two */
+  guint32                tip;         /* entry number of the best tip plus one, 0 if none */
+  bitcoin_chain_fragment_t *fragments;
+  guint32                num_fragments;
+  guint32                max_fragments;
+  GHashTable            *waiting;     /* missing parent hash -> fragment number plus one */
+} bitcoin_chain_t;
+
+static bitcoin_chain_t header_chain;
 
-/**
- * Extract a variable length integer from a tvbuff
+/*
+ * Commands of the PDUs found in the frame being dissected.  The Info
+ * column is built from it once all of them are done, with repeated
+ * commands counted ("inv x37, ping, tx x4" using a multiplication sign).
  */
-static void
-get_varint(tvbuff_t *tvb, const gint offset, gint *length, guint64 *ret)
-{
-  guint value;
+#define BITCOIN_INFO_MAX_COMMANDS 16
 
-  /* Note: just throw an exception if not enough  bytes are available in the tvbuff */
+typedef struct _bitcoin_info_command
+{
+  const gchar *command;
+  guint        count;
+  const gchar *detail;   /* key hash, shown if the command appears only once */
+} bitcoin_info_command_t;
 
-  /* calculate variable length */
-  value = tvb_get_guint8(tvb, offset);
-  if (value < 0xfd)
-  {
-    *length = 1;
-    *ret = value;
-    return;
-  }
+typedef struct _bitcoin_info_tally
+{
+  bitcoin_info_command_t commands[BITCOIN_INFO_MAX_COMMANDS];
+  guint                  num_commands;
+  guint                  current;   /* slot of the PDU being dissected */
+  guint                  other;     /* PDUs whose command didn't fit */
+} bitcoin_info_tally_t;
 
-  if (value == 0xfd)
-  {
-    *length = 3;
-    *ret = tvb_get_letohs(tvb, offset+1);
-    return;
-  }
-  if (value == 0xfe)
-  {
-    *length = 5;
-    *ret = tvb_get_letohl(tvb, offset+1);
-    return;
-  }
+static bitcoin_info_tally_t *info_tally = NULL;
 
-  *length = 9;
-  *ret = tvb_get_letoh64(tvb, offset+1);
-  return;
+/*
+ * Fee of every tx whose inputs were all found in the outpoint index, with
+ * the totals over its in-capture ancestors for package feerates.
+ */
 
-}
+/* ancestors remembered per tx, the mempool's limit not counting the tx */
+#define BITCOIN_MAX_ANCESTORS 24
 
-static void add_varint_item(proto_tree *tree, tvbuff_t *tvb, const gint offset, gint length,
-                            gint hf8, gint hf16, gint hf32, gint hf64)
+typedef struct _bitcoin_tx_info
 {
-  switch (length)
-  {
-  case 1:
-    proto_tree_add_item(tree, hf8,  tvb, offset, 1, ENC_LITTLE_ENDIAN);
-    break;
-  case 3:
-    proto_tree_add_item(tree, hf16, tvb, offset+1, 2, ENC_LITTLE_ENDIAN);
-    break;
-  case 5:
-    proto_tree_add_item(tree, hf32, tvb, offset+1, 4, ENC_LITTLE_ENDIAN);
-    break;
-  case 9:
-    proto_tree_add_item(tree, hf64, tvb, offset+1, 8, ENC_LITTLE_ENDIAN);
-    break;
-  }
-}
-
-/* Note: A number of the following message handlers include code of the form:
- *          ...
- *          guint64     count;
- *          ...
- *          for (; count > 0; count--)
- *          {
- *            proto_tree_add_item9...);
- *            offset += ...;
- *            proto_tree_add_item9...);
- *            offset += ...;
- *            ...
- *          }
- *          ...
- *
- * Issue if 'count' is a very large number:
- *    If 'tree' is NULL, then the result will be effectively (but not really)
- *    an infinite loop. This is true because if 'tree' is NULL then
- *    proto_tree_add_item(tree, ...) is effectively a no-op and will not throw
- *    an exception.
- *    So: the loop should be executed only when 'tree' is defined so that the
- *        proto_ calls will throw an exception when the tvb is used up;
- *        This should only take a few-hundred loops at most.
- *           https://bugs.wireshark.org/bugzilla/show_bug.cgi?id=8312
- */
-
-/**
- * Handler for version messages
- */
-static void
-dissect_bitcoin_msg_version(tvbuff_t *tvb, packet_info *pinfo _U_, proto_tree *tree)
+  guint64 txid;           /* first 64 bits of the txid, the hash key */
+  guint32 frame;          /* first seen in */
+  guint64 fee;
+  guint32 size;           /* virtual size */
+  guint64 ancestor_fee;   /* including the tx itself */
+  guint64 ancestor_size;
+  guint64 ancestors[BITCOIN_MAX_ANCESTORS];  /* txid keys, each once */
+  guint   ancestor_count;
+} bitcoin_tx_info_t;
+
+static GHashTable *tx_info_table = NULL;
+
+/* first frame each relayed txid was seen in, for the duplicate check and
+ * the object index */
+typedef struct _bitcoin_tx_seen
 {
-  proto_item *ti;
-  gint        varint_length;
-  guint64     user_agent_length;
-  guint32     offset = 0;
+  guint64 txid;           /* first 64 bits of the txid, the hash key */
+  guint32 first_frame;
+} bitcoin_tx_seen_t;
 
-  if (!tree)
-    return;
+static GHashTable *tx_seen_table = NULL;
 
-  ti   = proto_tree_add_item(tree, hf_bitcoin_msg_version, tvb, offset, -1, ENC_NA);
-  tree = proto_item_add_subtree(ti, ett_bitcoin_msg);
+/* txids and block hashes already computed, so that revisiting a frame
+ * (selecting it, refiltering) doesn't hash its txs and blocks again */
+typedef struct _bitcoin_digest
+{
+  guint64 key;            /* frame, message in the frame and offset in the message */
+  guint32 length;
+  guint8  digest[32];
+} bitcoin_digest_t;
 
-  proto_tree_add_item(tree, hf_msg_version_version, tvb, offset, 4, ENC_LITTLE_ENDIAN);
-  offset += 4;
+/* where the parts of a serialized tx are, relative to its start */
+typedef struct _bitcoin_tx_layout
+{
+  guint32 length;         /* of the whole serialization */
+  guint32 witness;        /* start of the witness stacks (BIP 144), 0 without */
+} bitcoin_tx_layout_t;
 
-  ti = proto_tree_add_item(tree, hf_msg_version_services, tvb, offset, 8, ENC_LITTLE_ENDIAN);
-  create_services_tree(tvb, ti, offset);
-  offset += 8;
+static GHashTable *digest_cache_table = NULL;
+static guint32     digest_frame = 0;    /* message being dissected */
+static guint32     digest_msg = 0;
+static gboolean    digest_in_frame = FALSE;  /* a frame is being dissected */
 
-  proto_tree_add_item(tree, hf_msg_version_timestamp, tvb, offset, 8, ENC_TIME_TIMESPEC|ENC_LITTLE_ENDIAN);
-  offset += 8;
+/* parents looked at when summing up ancestors */
+#define BITCOIN_MAX_PARENTS 256
 
-  ti = proto_tree_add_item(tree, hf_msg_version_addr_me, tvb, offset, 26, ENC_NA);
-  create_address_tree(tvb, ti, offset);
-  offset += 26;
+/* per gossiped address data handed to the tap */
+typedef struct _bitcoin_tap_addr
+{
+  guint8   network;
+  gboolean is_new;      /* first time the address was gossiped */
+  gboolean new_relay;   /* first time this peer gossiped it */
+} bitcoin_tap_addr_t;
+
+/* data handed to the "bitcoin" tap */
+#define BITCOIN_TAP_TX    1
+#define BITCOIN_TAP_ADDR  2
+#define BITCOIN_TAP_RELAY 3
+#define BITCOIN_TAP_BLOCK 4
+#define BITCOIN_TAP_STATE 5
+
+typedef struct _bitcoin_tap_info
+{
+  guint    type;     /* BITCOIN_TAP_* */
 
-  ti = proto_tree_add_item(tree, hf_msg_version_addr_you, tvb, offset, 26, ENC_NA);
-  create_address_tree(tvb, ti, offset);
-  offset += 26;
+  /* BITCOIN_TAP_TX, BITCOIN_TAP_RELAY */
+  guint32  size;
+  guint64  fee;
+  gdouble  feerate;  /* sat/vB */
+  gboolean duplicate;
 
-  proto_tree_add_item(tree, hf_msg_version_nonce, tvb, offset, 8, ENC_LITTLE_ENDIAN);
-  offset += 8;
+  /* BITCOIN_TAP_ADDR */
+  guint               addr_count;
+  bitcoin_tap_addr_t *addrs;
 
-  /* find var_str user_agent */
+  /* BITCOIN_TAP_BLOCK, queued for the first receipt from each peer */
+  gboolean first_receipt;    /* no peer delivered the block before */
+  gdouble  first_delay;      /* ms behind the first peer */
+  gdouble  announce_delay;   /* ms since the first announcement, < 0 if none */
 
-  get_varint(tvb, offset, &varint_length, &user_agent_length);
-  add_varint_item(tree, tvb, offset, varint_length, hf_msg_version_user_agent_length8, hf_msg_version_user_agent_length16,
-                  hf_msg_version_user_agent_length32, hf_msg_version_user_agent_length64);
-  offset += varint_length;
+  /* BITCOIN_TAP_STATE, queued for messages that dropped analysis state */
+  const guint32 *evicted;    /* per BITCOIN_STATE_* */
+} bitcoin_tap_info_t;
 
-  proto_tree_add_item(tree, hf_msg_version_user_agent, tvb, offset, user_agent_length, ENC_ASCII|ENC_NA);
-  offset += user_agent_length;
+/* data handed to the "bitcoin_perf" tap, one per dissected message */
+typedef struct _bitcoin_perf
+{
+  const gchar *command;
+  guint32      bytes;   /* payload */
+  gdouble      usecs;   /* spent in the message handler */
+} bitcoin_perf_t;
 
-  proto_tree_add_item(tree, hf_msg_version_start_height, tvb, offset, 4, ENC_LITTLE_ENDIAN);
-}
+static GTimer *perf_timer = NULL;
 
 /*
- * Handler for address messages
+ * Capture-wide table of gossiped addresses (addr and addrv2 entries).
+ * Both tables are keyed by a 64 bit hash rather than the full address,
+ * which can be up to 32 bytes for Tor v3 and I2P.
  */
-static void
-dissect_bitcoin_msg_addr(tvbuff_t *tvb, packet_info *pinfo _U_, proto_tree *tree)
+typedef struct _bitcoin_addr_info
 {
-  proto_item *ti;
-  gint        length;
-  guint64     count;
-  guint32     offset = 0;
-
-  if (!tree)
-    return;
+  guint64 key;          /* hash of network id, address and port */
+  guint64 services;     /* as last advertised */
+  guint32 first_frame;
+  guint32 last_frame;
+  guint32 peers;        /* distinct peers that relayed it */
+  guint32 sightings;
+  guint8  network;
+} bitcoin_addr_info_t;
+
+/* (address, relaying peer) pairs seen so far */
+typedef struct _bitcoin_addr_relay
+{
+  guint64 key;
+  guint32 first_frame;
+} bitcoin_addr_relay_t;
 
-  ti   = proto_tree_add_item(tree, hf_bitcoin_msg_addr, tvb, offset, -1, ENC_NA);
-  tree = proto_item_add_subtree(ti, ett_bitcoin_msg);
+static GHashTable *addr_table = NULL;
+static GHashTable *addr_relay_table = NULL;
 
-  get_varint(tvb, offset, &length, &count);
-  add_varint_item(tree, tvb, offset, length, hf_msg_addr_count8, hf_msg_addr_count16,
-                  hf_msg_addr_count32, hf_msg_addr_count64);
-  offset += length;
+/*
+ * When each block was first announced (inv, headers or cmpctblock) and
+ * first received in full, both capture-wide and per sending peer.
+ */
+typedef struct _bitcoin_block_prop
+{
+  guint64  hash;                /* first 64 bits of the block hash, the hash key */
+  guint32  announce_frame;      /* 0 if not announced */
+  nstime_t announce_time;
+  guint32  receive_frame;       /* 0 if not received in full */
+  nstime_t receive_time;
+  nstime_t last_receive_time;   /* latest first receipt from a peer */
+  guint32  peers;               /* peers the block was received from */
+} bitcoin_block_prop_t;
+
+/* (block, sending peer) pairs seen so far */
+typedef struct _bitcoin_block_peer
+{
+  guint64 key;
+  guint32 first_frame;
+} bitcoin_block_peer_t;
 
-  for (; count > 0; count--)
-  {
-    proto_tree *subtree;
+static GHashTable *block_prop_table = NULL;
+static GHashTable *block_peer_table = NULL;
 
-    ti = proto_tree_add_item(tree, hf_msg_addr_address, tvb, offset, 30, ENC_NA);
-    subtree = create_address_tree(tvb, ti, offset+4);
+/*
+ * Inventory requested through getdata, in flight until a tx, block,
+ * cmpctblock or notfound message for it comes from the other side.
+ * Requests are owned by getdata_req_table; the other two tables just
+ * point into it.
+ */
+typedef struct _bitcoin_getdata_req
+{
+  guint64  key;            /* hash of request frame and inventory hash */
+  guint64  pending_key;    /* hash of conversation, direction and inventory hash */
+  guint64  answer_key;     /* hash of answer frame and inventory hash */
+  guint32  frame;
+  nstime_t time;
+  guint32  answer_frame;   /* 0 while in flight */
+  nstime_t answer_time;
+  gboolean notfound;
+  bitcoin_conv_info_t *conv_info;  /* of the request */
+  guint    direction;
+} bitcoin_getdata_req_t;
+
+static GHashTable *getdata_req_table = NULL;
+static GHashTable *getdata_pending_table = NULL;
+static GHashTable *getdata_answer_table = NULL;
+static nstime_t    getdata_last_time;  /* of the last frame seen, for requests never answered */
 
-    proto_tree_add_item(subtree, hf_msg_addr_timestamp, tvb, offset, 4, ENC_TIME_TIMESPEC|ENC_LITTLE_ENDIAN);
-    offset += 26;
-    offset += 4;
-  }
-}
+/*
+ * Memory budget of the analysis state, bitcoin.state_budget MB per table.
+ *
+ * The GHashTable based tables remember the keys of their entries in
+ * insertion order and, once over budget, evict the oldest entries first;
+ * captures are read in time order, so this drops the state of the frames
+ * furthest back.  Lookups treat an evicted entry like one never seen, so
+ * only generated cross-references go missing.  The outpoint index and the
+ * header chain can't lose entries and just stop growing instead.
+ */
+#define BITCOIN_STATE_OUTPOINT    0
+#define BITCOIN_STATE_CHAIN       1
+#define BITCOIN_STATE_TX_INFO     2
+#define BITCOIN_STATE_TX_SEEN     3
+#define BITCOIN_STATE_ADDR        4
+#define BITCOIN_STATE_ADDR_RELAY  5
+#define BITCOIN_STATE_BLOCK_PROP  6
+#define BITCOIN_STATE_BLOCK_PEER  7
+#define BITCOIN_STATE_GETDATA     8
+#define BITCOIN_STATE_DIGEST      9
+#define BITCOIN_STATE_COUNT       10
+
+/* per entry cost of a hash table slot and a queue link on top of the entry */
+#define BITCOIN_STATE_OVERHEAD    56
+
+typedef struct _bitcoin_state_budget
+{
+  const gchar  *name;
+  GHashTable  **table;          /* NULL for the outpoint index and header chain */
+  gsize         entry_size;
+  void        (*evict)(gpointer entry);  /* unlinks an entry from other tables */
+  GQueue       *order;          /* keys of the entries, oldest first */
+} bitcoin_state_budget_t;
 
 /**
- * Handler for inventory messages
+ * Forget an evicted request; one still in flight no longer counts
  */
 static void
-dissect_bitcoin_msg_inv(tvbuff_t *tvb, packet_info *pinfo _U_, proto_tree *tree)
+bitcoin_getdata_evict(gpointer entry)
 {
-  proto_item *ti;
-  gint        length;
-  guint64     count;
-  guint32     offset = 0;
+  bitcoin_getdata_req_t *req = (bitcoin_getdata_req_t *)entry;
 
-  if (!tree)
-    return;
+  if (req->answer_frame == 0)
+  {
+    if (g_hash_table_lookup(getdata_pending_table, &req->pending_key) == req)
+      g_hash_table_remove(getdata_pending_table, &req->pending_key);
+    req->conv_info->inflight[req->direction]--;
+  }
+  else if (g_hash_table_lookup(getdata_answer_table, &req->answer_key) == req)
+    g_hash_table_remove(getdata_answer_table, &req->answer_key);
+}
 
-  ti   = proto_tree_add_item(tree, hf_bitcoin_msg_inv, tvb, offset, -1, ENC_NA);
-  tree = proto_item_add_subtree(ti, ett_bitcoin_msg);
+static bitcoin_state_budget_t state_budgets[BITCOIN_STATE_COUNT] =
+{
+  { "outpoint index",    NULL, 0, NULL, NULL },
+  { "header chain",      NULL, 0, NULL, NULL },
+  { "tx fee",            &tx_info_table,      sizeof(bitcoin_tx_info_t) + BITCOIN_STATE_OVERHEAD, NULL, NULL },
+  { "tx relay",          &tx_seen_table,      sizeof(bitcoin_tx_seen_t) + BITCOIN_STATE_OVERHEAD, NULL, NULL },
+  { "address",           &addr_table,         sizeof(bitcoin_addr_info_t) + BITCOIN_STATE_OVERHEAD, NULL, NULL },
+  { "address relay",     &addr_relay_table,   sizeof(bitcoin_addr_relay_t) + BITCOIN_STATE_OVERHEAD, NULL, NULL },
+  { "block propagation", &block_prop_table,   sizeof(bitcoin_block_prop_t) + BITCOIN_STATE_OVERHEAD, NULL, NULL },
+  { "block peer",        &block_peer_table,   sizeof(bitcoin_block_peer_t) + BITCOIN_STATE_OVERHEAD, NULL, NULL },
+  /* also in the pending or answer table */
+  { "getdata",           &getdata_req_table,  sizeof(bitcoin_getdata_req_t) + 2 * BITCOIN_STATE_OVERHEAD,
+    bitcoin_getdata_evict, NULL },
+  { "digest cache",      &digest_cache_table, sizeof(bitcoin_digest_t) + BITCOIN_STATE_OVERHEAD, NULL, NULL }
+};
 
-  get_varint(tvb, offset, &length, &count);
-  add_varint_item(tree, tvb, offset, length, hf_msg_inv_count8, hf_msg_inv_count16,
-                  hf_msg_inv_count32, hf_msg_inv_count64);
+static const gchar *st_str_feerate = "Feerate (sat/vB)";
+static const gchar *st_str_feerate_by_minute = "Feerate by minute";
+static int st_node_feerate = -1;
+static int st_node_feerate_by_minute = -1;
 
-  offset += length;
+/* each bucket holds the feerates from its bound up to the next one's */
+typedef struct _bitcoin_feerate_bucket
+{
+  gdouble      bound;     /* sat/vB */
+  const gchar *name;
+} bitcoin_feerate_bucket_t;
 
-  for (; count > 0; count--)
-  {
-    proto_tree *subtree;
+static const bitcoin_feerate_bucket_t feerate_buckets[] =
+{
+  {   0.0, "0 to 1" },
+  {   1.0, "1 to 2" },
+  {   2.0, "2 to 5" },
+  {   5.0, "5 to 10" },
+  {  10.0, "10 to 20" },
+  {  20.0, "20 to 50" },
+  {  50.0, "50 to 100" },
+  { 100.0, "100 to 500" },
+  { 500.0, "500 and more" }
+};
 
-    ti = proto_tree_add_text(tree, tvb, offset, 36, "Inventory vector");
-    subtree = proto_item_add_subtree(ti, ett_inv_list);
+static const gchar *st_str_relay_txs = "Tx messages";
+static const gchar *st_str_relay_dups = "Duplicate tx messages";
+static const gchar *st_str_relay_bytes = "Tx bytes by peer";
+static const gchar *st_str_relay_wasted = "Redundant tx bytes by peer";
+static int st_node_relay_bytes = -1;
+static int st_node_relay_wasted = -1;
+
+static const gchar *st_str_addr_msgs = "Addr messages by entry count";
+static const gchar *st_str_addr_entries = "Gossiped addresses";
+static const gchar *st_str_addr_new = "New addresses";
+static const gchar *st_str_addr_new_relays = "New (address, peer) relays";
+static const gchar *st_str_addr_peers = "Relaying peers";
+static int st_node_addr_msgs = -1;
+static int st_node_addr_entries = -1;
+static int st_node_addr_peers = -1;
+
+static const gchar *st_str_blockprop_blocks = "Blocks received";
+static const gchar *st_str_blockprop_first = "First to deliver";
+static const gchar *st_str_blockprop_announce = "First announcement to receipt (ms)";
+static const gchar *st_str_blockprop_delay = "Delay behind first peer (ms)";
+static const gchar *st_str_blockprop_by_peer = "Delay behind first peer by peer (ms)";
+static int st_node_blockprop_first = -1;
+static int st_node_blockprop_by_peer = -1;
+static GHashTable *st_blockprop_peers = NULL;
+
+static const gchar *st_str_perf_msgs = "Messages by command";
+static const gchar *st_str_perf_bytes = "Payload bytes by command";
+static const gchar *st_str_perf_usecs = "Dissection time by command (us)";
+static int st_node_perf_msgs = -1;
+static int st_node_perf_bytes = -1;
+static int st_node_perf_usecs = -1;
+static GHashTable *st_perf_usecs = NULL;    /* exact total per command, shown rounded */
+static gdouble     st_perf_usecs_total = 0;
+
+static const gchar *st_str_state_dropped = "Entries dropped by table";
+static int st_node_state_dropped = -1;
 
-    proto_tree_add_item(subtree, hf_msg_inv_type, tvb, offset, 4, ENC_LITTLE_ENDIAN);
-    offset += 4;
+static guint
+get_bitcoin_pdu_length(packet_info *pinfo _U_, tvbuff_t *tvb, int offset)
+{
+  guint32 length;
+  guint32 payload_length;
+  length = BITCOIN_HEADER_LENGTH;
 
-    proto_tree_add_item(subtree, hf_msg_inv_hash, tvb, offset, 32, ENC_NA);
-    offset += 32;
+  /* never wait for (and buffer) a payload no peer would accept, just take
+   * what this segment holds */
+  payload_length = tvb_get_letohl(tvb, offset+16);
+  if (bitcoin_max_payload && payload_length > bitcoin_max_payload)
+    return tvb_reported_length_remaining(tvb, offset);
+
+  /* add payload length */
+  length += payload_length;
+
+  return length;
+}
+
+/**
+ * Get (or create) the state kept for a Bitcoin TCP connection
+ */
+static bitcoin_conv_info_t *
+get_bitcoin_conv_info(packet_info *pinfo)
+{
+  conversation_t      *conversation;
+  bitcoin_conv_info_t *conv_info;
+
+  conversation = find_or_create_conversation(pinfo);
+  conv_info    = (bitcoin_conv_info_t *)conversation_get_proto_data(conversation, proto_bitcoin);
+  if (!conv_info)
+  {
+    conv_info = se_new0(bitcoin_conv_info_t);
+    SE_COPY_ADDRESS(&conv_info->initiator_addr, &pinfo->src);
+    conv_info->initiator_port = pinfo->srcport;
+    conversation_add_proto_data(conversation, proto_bitcoin, conv_info);
   }
+
+  return conv_info;
 }
 
 /**
- * Handler for getdata messages
+ * 0 if the packet was sent by the side that spoke first, 1 otherwise
  */
-static void
-dissect_bitcoin_msg_getdata(tvbuff_t *tvb, packet_info *pinfo _U_, proto_tree *tree)
+static guint
+get_bitcoin_direction(bitcoin_conv_info_t *conv_info, packet_info *pinfo)
 {
-  proto_item *ti;
-  gint        length;
-  guint64     count;
-  guint32     offset = 0;
+  if (pinfo->srcport == conv_info->initiator_port &&
+      ADDRESSES_EQUAL(&pinfo->src, &conv_info->initiator_addr))
+    return 0;
 
-  if (!tree)
-    return;
+  return 1;
+}
 
-  ti   = proto_tree_add_item(tree, hf_bitcoin_msg_getdata, tvb, offset, -1, ENC_NA);
-  tree = proto_item_add_subtree(ti, ett_bitcoin_msg);
+/**
+ * Layout of the messages of a protocol version
+ */
+static const bitcoin_version_layout_t *
+get_bitcoin_version_layout(guint32 version)
+{
+  guint i;
 
-  get_varint(tvb, offset, &length, &count);
-  add_varint_item(tree, tvb, offset, length, hf_msg_getdata_count8, hf_msg_getdata_count16,
-                  hf_msg_getdata_count32, hf_msg_getdata_count64);
+  for (i = 0; version < version_layouts[i].min_version; i++)
+    ;
 
-  offset += length;
+  return &version_layouts[i];
+}
 
-  for (; count > 0; count--)
-  {
-    proto_tree *subtree;
+/**
+ * Layout negotiated for the connection, the newest one if the version
+ * handshake wasn't captured
+ */
+static const bitcoin_version_layout_t *
+get_bitcoin_conv_layout(packet_info *pinfo)
+{
+  bitcoin_conv_info_t *conv_info = get_bitcoin_conv_info(pinfo);
 
-    ti = proto_tree_add_text(tree, tvb, offset, 36, "Inventory vector");
-    subtree = proto_item_add_subtree(ti, ett_getdata_list);
+  return conv_info->layout ? conv_info->layout : &version_layouts[0];
+}
 
-    proto_tree_add_item(subtree, hf_msg_getdata_type, tvb, offset, 4, ENC_LITTLE_ENDIAN);
-    offset += 4;
+/**
+ * Get the per-frame data, creating it (on the first pass) if asked to
+ */
+static bitcoin_frame_info_t *
+get_bitcoin_frame_info(packet_info *pinfo, gboolean create)
+{
+  bitcoin_frame_info_t *frame_info;
 
-    proto_tree_add_item(subtree, hf_msg_getdata_hash, tvb, offset, 32, ENC_NA);
-    offset += 32;
+  frame_info = (bitcoin_frame_info_t *)p_get_proto_data(pinfo->fd, proto_bitcoin);
+  if (!frame_info && create)
+  {
+    frame_info = se_new0(bitcoin_frame_info_t);
+    p_add_proto_data(pinfo->fd, proto_bitcoin, frame_info);
   }
+
+  return frame_info;
 }
 
 /**
- * Handler for notfound messages
+ * Record analysis state entries dropped while dissecting a frame
  */
 static void
-dissect_bitcoin_msg_notfound(tvbuff_t *tvb, packet_info *pinfo _U_, proto_tree *tree)
+bitcoin_state_dropped(guint table, guint32 count, packet_info *pinfo)
 {
-  proto_item *ti;
-  gint        length;
-  guint64     count;
-  guint32     offset = 0;
+  bitcoin_frame_info_t *frame_info;
 
-  if (!tree)
-    return;
+  frame_info = get_bitcoin_frame_info(pinfo, TRUE);
+  if (!frame_info->evicted)
+  {
+    frame_info->evicted     = (guint32 *)se_alloc0(BITCOIN_STATE_COUNT * sizeof(guint32));
+    frame_info->evicted_msg = digest_msg;
+  }
+  frame_info->evicted[table] += count;
+}
 
-  ti   = proto_tree_add_item(tree, hf_bitcoin_msg_notfound, tvb, offset, -1, ENC_NA);
-  tree = proto_item_add_subtree(ti, ett_bitcoin_msg);
+/**
+ * Add an entry to one of the budgeted tables, evicting the oldest entries
+ * once the table is over budget
+ */
+static void
+bitcoin_budget_insert(guint table, guint64 *key, gpointer entry, packet_info *pinfo)
+{
+  bitcoin_state_budget_t *budget = &state_budgets[table];
+  guint64                 max_entries;
+  guint32                 evicted = 0;
+  gpointer                oldest;
+  gpointer                oldest_entry;
 
-  get_varint(tvb, offset, &length, &count);
-  add_varint_item(tree, tvb, offset, length, hf_msg_notfound_count8, hf_msg_notfound_count16,
-                  hf_msg_notfound_count32, hf_msg_notfound_count64);
+  g_hash_table_insert(*budget->table, key, entry);
+  g_queue_push_tail(budget->order, key);
 
-  offset += length;
+  if (bitcoin_state_budget == 0)
+    return;
 
-  for (; count > 0; count--)
+  max_entries = (guint64)bitcoin_state_budget * 1024 * 1024 / budget->entry_size;
+  while (g_queue_get_length(budget->order) > max_entries)
   {
-    proto_tree *subtree;
+    oldest       = g_queue_pop_head(budget->order);
+    oldest_entry = g_hash_table_lookup(*budget->table, oldest);
+    if (!oldest_entry)
+      continue;
+    if (budget->evict)
+      budget->evict(oldest_entry);
+    g_hash_table_remove(*budget->table, oldest);
+    evicted++;
+  }
 
-    ti = proto_tree_add_text(tree, tvb, offset, 36, "Inventory vector");
-    subtree = proto_item_add_subtree(ti, ett_notfound_list);
+  /* the digest cache only saves work, losing entries changes nothing shown */
+  if (evicted && pinfo)
+    bitcoin_state_dropped(table, evicted, pinfo);
+}
 
-    proto_tree_add_item(subtree, hf_msg_notfound_type, tvb, offset, 4, ENC_LITTLE_ENDIAN);
-    offset += 4;
+static void
+bitcoin_digest_frame_end(void)
+{
+  digest_in_frame = FALSE;
+}
 
-    proto_tree_add_item(subtree, hf_msg_notfound_hash, tvb, offset, 32, ENC_NA);
-    offset += 32;
+/**
+ * Number the messages of a frame in dissection order, which is the same
+ * on every pass, for the digest cache keys; numbering restarts with each
+ * dissection of a frame, also when it is dissected twice in a row
+ */
+static void
+bitcoin_digest_next_message(packet_info *pinfo)
+{
+  if (!digest_in_frame || digest_frame != pinfo->fd->num)
+  {
+    digest_in_frame = TRUE;
+    digest_frame    = pinfo->fd->num;
+    digest_msg      = 0;
+    register_frame_end_routine(bitcoin_digest_frame_end);
   }
+  else
+    digest_msg += 1;
 }
 
 /**
- * Handler for getblocks messages
+ * Double SHA-256 over parts of the length bytes at offset, given as
+ * part_count (start, length) pairs relative to offset; the txid of a
+ * segwit tx leaves out the marker, flag and witness
+ *
+ * Digests are cached by position and validated by the number of bytes
+ * hashed, unless cache is FALSE for one that would just evict another.
  */
 static void
-dissect_bitcoin_msg_getblocks(tvbuff_t *tvb, packet_info *pinfo _U_, proto_tree *tree)
+get_bitcoin_hash_parts(tvbuff_t *tvb, gint offset, const guint32 *parts, guint part_count, gboolean cache,
+                       guint8 *digest)
 {
-  proto_item *ti;
-  gint        length;
-  guint64     count;
-  guint32     offset = 0;
+  GChecksum        *checksum;
+  gsize             digest_length = 32;
+  bitcoin_digest_t *cached = NULL;
+  guint64           key = 0;
+  guint32           hashed = 0;
+  guint             i;
+
+  for (i = 0; i < part_count; i++)
+    hashed += parts[2*i + 1];
+
+  /* 8 bits of message number and 24 bits of offset cover any sane frame */
+  if (cache && bitcoin_cache_digests && digest_msg < 0x100 && offset < 0x1000000)
+  {
+    key = ((guint64)digest_frame << 32) | (digest_msg << 24) | (guint32)offset;
+    cached = (bitcoin_digest_t *)g_hash_table_lookup(digest_cache_table, &key);
+    if (cached && cached->length == hashed)
+    {
+      memcpy(digest, cached->digest, 32);
+      return;
+    }
+  }
 
-  if (!tree)
-    return;
+  checksum = g_checksum_new(G_CHECKSUM_SHA256);
+  for (i = 0; i < part_count; i++)
+    g_checksum_update(checksum, tvb_get_ptr(tvb, offset + parts[2*i], parts[2*i + 1]), parts[2*i + 1]);
+  g_checksum_get_digest(checksum, digest, &digest_length);
 
-  ti   = proto_tree_add_item(tree, hf_bitcoin_msg_getblocks, tvb, offset, -1, ENC_NA);
-  tree = proto_item_add_subtree(ti, ett_bitcoin_msg);
+  g_checksum_reset(checksum);
+  g_checksum_update(checksum, digest, 32);
+  digest_length = 32;
+  g_checksum_get_digest(checksum, digest, &digest_length);
+  g_checksum_free(checksum);
 
-  /* why the protcol version is sent here nobody knows */
-  proto_tree_add_item(tree, hf_msg_version_version, tvb, offset, 4, ENC_LITTLE_ENDIAN);
-  offset += 4;
+  if (key)
+  {
+    if (!cached)
+    {
+      cached = g_new(bitcoin_digest_t, 1);
+      cached->key = key;
+      bitcoin_budget_insert(BITCOIN_STATE_DIGEST, &cached->key, cached, NULL);
+    }
+    cached->length = hashed;
+    memcpy(cached->digest, digest, 32);
+  }
+}
 
-  get_varint(tvb, offset, &length, &count);
-  add_varint_item(tree, tvb, offset, length, hf_msg_getblocks_count8, hf_msg_getblocks_count16,
-                  hf_msg_getblocks_count32, hf_msg_getblocks_count64);
+/**
+ * Double SHA-256 as used for txids and block hashes
+ */
+static void
+get_bitcoin_hash(tvbuff_t *tvb, gint offset, gint length, guint8 *digest)
+{
+  guint32 parts[2];
 
-  offset += length;
+  parts[0] = 0;
+  parts[1] = length;
+  get_bitcoin_hash_parts(tvb, offset, parts, 1, TRUE, digest);
+}
 
-  for (; count > 0; count--)
+/**
+ * Format a 32 byte hash the way block explorers and RPC show it, i.e.
+ * as hex with the byte order reversed
+ */
+static gchar *
+bitcoin_hash_to_str(const guint8 *hash)
+{
+  static const gchar hex[] = "0123456789abcdef";
+  gchar *str;
+  gchar *p;
+  gint   i;
+
+  str = (gchar *)ep_alloc(65);
+  p   = str;
+  for (i = 31; i >= 0; i--)
   {
-    proto_tree_add_item(tree, hf_msg_getblocks_start, tvb, offset, 32, ENC_NA);
-    offset += 32;
+    *p++ = hex[hash[i] >> 4];
+    *p++ = hex[hash[i] & 0x0f];
   }
+  *p = '\0';
 
-  proto_tree_add_item(tree, hf_msg_getblocks_stop, tvb, offset, 32, ENC_NA);
+  return str;
 }
 
 /**
- * Handler for getheaders messages
- * UNTESTED
+ * Count a PDU in the Info column tally
  */
 static void
-dissect_bitcoin_msg_getheaders(tvbuff_t *tvb, packet_info *pinfo _U_, proto_tree *tree)
+bitcoin_info_add(const gchar *command)
 {
-  proto_item *ti;
-  gint        length;
-  guint64     count;
-  guint32     offset = 0;
+  guint i;
 
-  if (!tree)
+  if (!info_tally)
     return;
 
-  ti   = proto_tree_add_item(tree, hf_bitcoin_msg_getheaders, tvb, offset, -1, ENC_NA);
-  tree = proto_item_add_subtree(ti, ett_bitcoin_msg);
-
-  get_varint(tvb, offset, &length, &count);
-  add_varint_item(tree, tvb, offset, length, hf_msg_getheaders_count8, hf_msg_getheaders_count16,
-                  hf_msg_getheaders_count32, hf_msg_getheaders_count64);
-
-  offset += length;
+  for (i = 0; i < info_tally->num_commands; i++)
+  {
+    if (strcmp(info_tally->commands[i].command, command) == 0)
+      break;
+  }
 
-  for (; count > 0; count--)
+  if (i == info_tally->num_commands)
   {
-    proto_tree_add_item(tree, hf_msg_getheaders_start, tvb, offset, 32, ENC_NA);
-    offset += 32;
+    if (i == BITCOIN_INFO_MAX_COMMANDS)
+    {
+      info_tally->other++;
+      info_tally->current = BITCOIN_INFO_MAX_COMMANDS;
+      return;
+    }
+    info_tally->commands[i].command = command;
+    info_tally->num_commands++;
   }
 
-  proto_tree_add_item(tree, hf_msg_getheaders_stop, tvb, offset, 32, ENC_NA);
-  return;
+  info_tally->commands[i].count++;
+  info_tally->current = i;
 }
 
 /**
- * Handler for tx message body
+ * Attach the key hash (or similar) to the PDU being dissected
  */
-static guint32
-dissect_bitcoin_msg_tx_common(tvbuff_t *tvb, guint32 offset, packet_info *pinfo _U_, proto_tree *tree, guint msgnum)
+static void
+bitcoin_info_detail(const gchar *detail)
 {
-  proto_item *rti;
-  gint        count_length;
-  guint64     in_count;
-  guint64     out_count;
-
-  DISSECTOR_ASSERT(tree != NULL);
-
-  if (msgnum == 0) {
-    rti  = proto_tree_add_item(tree, hf_bitcoin_msg_tx, tvb, offset, -1, ENC_NA);
-  } else {
-    rti  = proto_tree_add_none_format(tree, hf_bitcoin_msg_tx, tvb, offset, -1, "Tx message [ %4d ]", msgnum);
-  }
-  tree = proto_item_add_subtree(rti, ett_bitcoin_msg);
-
-  proto_tree_add_item(tree, hf_msg_tx_version, tvb, offset, 4, ENC_LITTLE_ENDIAN);
-  offset += 4;
+  if (info_tally && info_tally->current < BITCOIN_INFO_MAX_COMMANDS)
+    info_tally->commands[info_tally->current].detail = detail;
+}
 
-  /* TxIn[] */
-  get_varint(tvb, offset, &count_length, &in_count);
-  add_varint_item(tree, tvb, offset, count_length, hf_msg_tx_in_count8, hf_msg_tx_in_count16,
-                  hf_msg_tx_in_count32, hf_msg_tx_in_count64);
+static void
+bitcoin_info_render(packet_info *pinfo, bitcoin_info_tally_t *tally)
+{
+  emem_strbuf_t *strbuf;
+  guint          i;
 
-  offset += count_length;
+  if (tally->num_commands == 0)
+    return;
 
-  /* TxIn
-   *   [36]  previous_output    outpoint
-   *   [1+]  script length      var_int
-   *   [ ?]  signature script   uchar[]
-   *   [ 4]  sequence           uint32_t
-   *
-   * outpoint (aka previous output)
-   *   [32]  hash               char[32
-   *   [ 4]  index              uint32_t
-   *
-   */
-  for (; in_count > 0; in_count--)
+  strbuf = ep_strbuf_new(NULL);
+  for (i = 0; i < tally->num_commands; i++)
   {
-    proto_tree *subtree;
-    proto_tree *prevtree;
-    proto_item *ti;
-    proto_item *pti;
-    guint64     script_length;
+    const bitcoin_info_command_t *command = &tally->commands[i];
 
-    get_varint(tvb, offset+36, &count_length, &script_length);
+    if (i > 0)
+      ep_strbuf_append(strbuf, ", ");
+    ep_strbuf_append(strbuf, command->command);
 
-    /* A funny script_length won't cause an exception since the field type is FT_NONE */
-    ti = proto_tree_add_item(tree, hf_msg_tx_in, tvb, offset,
-        36 + count_length + (guint)script_length + 4, ENC_NA);
-    subtree = proto_item_add_subtree(ti, ett_tx_in_list);
+    if (command->count > 1)
+      ep_strbuf_append_printf(strbuf, "\xc3\x97%u", command->count);
+    else if (command->detail)
+      ep_strbuf_append_printf(strbuf, " %s", command->detail);
+  }
 
-    /* previous output */
-    pti = proto_tree_add_item(subtree, hf_msg_tx_in_prev_output, tvb, offset, 36, ENC_NA);
-    prevtree = proto_item_add_subtree(pti, ett_tx_in_outp);
+  if (tally->other > 0)
+    ep_strbuf_append_printf(strbuf, ", %u more", tally->other);
 
-    proto_tree_add_item(prevtree, hf_msg_tx_in_prev_outp_hash, tvb, offset, 32, ENC_NA);
-    offset += 32;
+  /* TCP may call us again for the rest of the frame */
+  col_append_sep_str(pinfo->cinfo, COL_INFO, ", ", strbuf->str);
+}
 
-    proto_tree_add_item(prevtree, hf_msg_tx_in_prev_outp_index, tvb, offset, 4, ENC_LITTLE_ENDIAN);
-    offset += 4;
-    /* end previous output */
+/**
+ * Byte-reversed copy of a 32 byte hash, so FT_BYTES fields show (and
+ * display filters match) it the way block explorers and RPC show it
+ */
+static void
+bitcoin_hash_reverse(const guint8 *hash, guint8 *reversed)
+{
+  gint i;
 
-    add_varint_item(subtree, tvb, offset, count_length, hf_msg_tx_in_script8, hf_msg_tx_in_script16,
-                    hf_msg_tx_in_script32, hf_msg_tx_in_script64);
+  for (i = 0; i < 32; i++)
+    reversed[i] = hash[31 - i];
+}
 
-    offset += count_length;
+/**
+ * Hand a block or tx payload to the export object tap, named by its block
+ * hash or txid
+ */
+static void
+bitcoin_eo_queue(tvbuff_t *tvb, packet_info *pinfo, const gchar *command, const guint8 *hash)
+{
+  bitcoin_eo_t *eo_info;
+  guint32       length;
 
-    if ((offset + script_length) > G_MAXINT)
-      THROW(ReportedBoundsError);  /* special check since script_length is guint64 */
+  /* can't export what wasn't captured */
+  length = tvb_length(tvb);
+  if (length < tvb_reported_length(tvb))
+    return;
 
-    proto_tree_add_item(subtree, hf_msg_tx_in_sig_script, tvb, offset, (guint)script_length, ENC_NA);
-    offset += (guint)script_length;
+  eo_info = ep_new(bitcoin_eo_t);
+  eo_info->command      = command;
+  eo_info->hash         = bitcoin_hash_to_str(hash);
+  eo_info->payload_len  = length;
+  eo_info->payload_data = tvb_get_ptr(tvb, 0, length);
 
-    proto_tree_add_item(subtree, hf_msg_tx_in_seq, tvb, offset, 4, ENC_LITTLE_ENDIAN);
-    offset += 4;
-  }
+  tap_queue_packet(bitcoin_eo_tap, pinfo, eo_info);
+}
 
-  /* TxOut[] */
-  get_varint(tvb, offset, &count_length, &out_count);
-  add_varint_item(tree, tvb, offset, count_length, hf_msg_tx_out_count8, hf_msg_tx_out_count16,
-                  hf_msg_tx_out_count32, hf_msg_tx_out_count64);
+static guint32
+outpoint_hash(guint64 txid, guint32 vout)
+{
+  /* the txid is already uniformly distributed */
+  return (guint32)(txid >> 32) ^ (guint32)txid ^ (vout * 0x9E3779B1);
+}
 
-  offset += count_length;
+static bitcoin_outpoint_t *
+outpoint_table_find_slot(bitcoin_outpoint_t *slots, guint32 size, guint64 txid, guint32 vout)
+{
+  guint32 i;
 
-  /*  TxOut
-   *    [ 8] value
-   *    [1+] script length [var_int]
-   *    [ ?] script
-   */
-  for (; out_count > 0; out_count--)
+  for (i = outpoint_hash(txid, vout) & (size - 1); ; i = (i + 1) & (size - 1))
   {
-    proto_item *ti;
-    proto_tree *subtree;
-    guint64     script_length;
-
-    get_varint(tvb, offset+8, &count_length, &script_length);
-
-    /* A funny script_length won't cause an exception since the field type is FT_NONE */
-    ti = proto_tree_add_item(tree, hf_msg_tx_out, tvb, offset,
-                             8 + count_length + (guint)script_length , ENC_NA);
-    subtree = proto_item_add_subtree(ti, ett_tx_out_list);
-
-    proto_tree_add_item(subtree, hf_msg_tx_out_value, tvb, offset, 8, ENC_LITTLE_ENDIAN);
-    offset += 8;
-
-    add_varint_item(subtree, tvb, offset, count_length, hf_msg_tx_out_script8, hf_msg_tx_out_script16,
-                    hf_msg_tx_out_script32, hf_msg_tx_out_script64);
+    if (slots[i].frame == 0 || (slots[i].txid == txid && slots[i].vout == vout))
+      return &slots[i];
+  }
+}
 
-    offset += count_length;
+/**
+ * Grow the outpoint table, returns FALSE once the memory budget is reached
+ */
+static gboolean
+outpoint_table_grow(void)
+{
+  bitcoin_outpoint_t *slots;
+  guint32             size;
+  guint32             i;
 
-    if ((offset + script_length) > G_MAXINT)
-      THROW(ReportedBoundsError);  /* special check since script_length is guint64 */
+  size = outpoint_table.size ? outpoint_table.size * 2 : 4096;
+  if ((guint64)size * sizeof(bitcoin_outpoint_t) > (guint64)bitcoin_outpoint_index_size * 1024 * 1024)
+    return FALSE;
 
-    proto_tree_add_item(subtree, hf_msg_tx_out_script, tvb, offset, (guint)script_length, ENC_NA);
-    offset += (guint)script_length;
+  slots = g_new0(bitcoin_outpoint_t, size);
+  for (i = 0; i < outpoint_table.size; i++)
+  {
+    if (outpoint_table.slots[i].frame != 0)
+      *outpoint_table_find_slot(slots, size, outpoint_table.slots[i].txid,
+                                outpoint_table.slots[i].vout) = outpoint_table.slots[i];
   }
 
-  proto_tree_add_item(tree, hf_msg_tx_lock_time, tvb, offset, 4, ENC_LITTLE_ENDIAN);
-  offset += 4;
-
-  /* needed for block nesting */
-  proto_item_set_len(rti, offset);
+  g_free(outpoint_table.slots);
+  outpoint_table.slots = slots;
+  outpoint_table.size  = size;
 
-  return offset;
+  return TRUE;
 }
 
 /**
- * Handler for tx message
+ * Remember an output; the first frame it was seen in wins
  */
 static void
-dissect_bitcoin_msg_tx(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
+outpoint_table_insert(const guint8 *txid, guint32 vout, packet_info *pinfo, guint64 value, guint8 script_type)
 {
-  if (!tree)
+  bitcoin_outpoint_t *slot;
+  guint64             key = pletoh64(txid);
+
+  /* keep the load factor below 3/4 */
+  if ((outpoint_table.used + 1) * 4 > outpoint_table.size * 3 && !outpoint_table_grow())
+  {
+    if (outpoint_table.size == 0 || outpoint_table_find_slot(outpoint_table.slots, outpoint_table.size, key, vout)->frame == 0)
+      bitcoin_state_dropped(BITCOIN_STATE_OUTPOINT, 1, pinfo);
+    return;
+  }
+
+  slot = outpoint_table_find_slot(outpoint_table.slots, outpoint_table.size, key, vout);
+  if (slot->frame != 0)
     return;
 
-  dissect_bitcoin_msg_tx_common(tvb, 0, pinfo, tree, 0);
+  slot->txid        = key;
+  slot->vout        = vout;
+  slot->frame       = pinfo->fd->num;
+  slot->value       = value;
+  slot->script_type = script_type;
+  outpoint_table.used++;
 }
 
+static const bitcoin_outpoint_t *
+outpoint_table_lookup(const guint8 *txid, guint32 vout)
+{
+  bitcoin_outpoint_t *slot;
 
-/**
- * Handler for block messages
- */
-
-static void
-dissect_bitcoin_msg_block(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
-{
-  proto_item *ti;
-  gint        length;
-  guint64     count;
-  guint       msgnum;
-  guint32     offset = 0;
+  if (outpoint_table.size == 0)
+    return NULL;
 
-  if (!tree)
-    return;
+  slot = outpoint_table_find_slot(outpoint_table.slots, outpoint_table.size, pletoh64(txid), vout);
+  return slot->frame != 0 ? slot : NULL;
+}
 
-  /*  Block
-   *    [ 4] version         uint32_t
-   *    [32] prev_block      char[32]
-   *    [32] merkle_root     char[32]
-   *    [ 4] timestamp       uint32_t  A unix timestamp ... (Currently limited to dates before the year 2106!)
-   *    [ 4] bits            uint32_t
-   *    [ 4] nonce           uint32_t
-   *    [ ?] txn_count       var_int
-   *    [ ?] txns            tx[]      Block transactions, in format of "tx" command
-   */
+/**
+ * Work represented by a block, 2^256 / target, from its compact target
+ */
+static gfloat
+bitcoin_block_work(guint32 bits)
+{
+  guint32 mantissa = bits & 0x007fffff;
+  gint    exponent = bits >> 24;
+  gdouble work;
 
-  ti   = proto_tree_add_item(tree, hf_bitcoin_msg_block, tvb, offset, -1, ENC_NA);
-  tree = proto_item_add_subtree(ti, ett_bitcoin_msg);
+  if (mantissa == 0 || (bits & 0x00800000))
+    return 0;
 
-  proto_tree_add_item(tree, hf_msg_block_version,     tvb, offset,  4, ENC_LITTLE_ENDIAN);
-  offset += 4;
+  /* target = mantissa * 256^(exponent - 3) */
+  work = ldexp(1.0 / mantissa, 256 - 8 * (exponent - 3));
+  return (gfloat)MIN(work, 1e30);
+}
 
-  proto_tree_add_item(tree, hf_msg_block_prev_block,  tvb, offset, 32, ENC_NA);
-  offset += 32;
+static guint32 *
+bitcoin_chain_find_slot(guint32 *index, guint32 size, guint64 hash)
+{
+  guint32 i;
 
-  proto_tree_add_item(tree, hf_msg_block_merkle_root, tvb, offset, 32, ENC_NA);
-  offset += 32;
+  /* the block hash is already uniformly distributed */
+  for (i = ((guint32)(hash >> 32) ^ (guint32)hash) & (size - 1); ; i = (i + 1) & (size - 1))
+  {
+    if (index[i] == 0 || header_chain.entries[index[i] - 1].hash == hash)
+      return &index[i];
+  }
+}
 
-  proto_tree_add_item(tree, hf_msg_block_time,        tvb, offset,  4, ENC_TIME_TIMESPEC|ENC_LITTLE_ENDIAN);
-  offset += 4;
+static bitcoin_chain_entry_t *
+bitcoin_chain_lookup(guint64 hash)
+{
+  guint32 *slot;
 
-  proto_tree_add_item(tree, hf_msg_block_bits,        tvb, offset,  4, ENC_LITTLE_ENDIAN);
-  offset += 4;
+  if (header_chain.index_size == 0)
+    return NULL;
 
-  proto_tree_add_item(tree, hf_msg_block_nonce,       tvb, offset,  4, ENC_LITTLE_ENDIAN);
-  offset += 4;
+  slot = bitcoin_chain_find_slot(header_chain.index, header_chain.index_size, hash);
+  return *slot ? &header_chain.entries[*slot - 1] : NULL;
+}
 
-  get_varint(tvb, offset, &length, &count);
-  add_varint_item(tree, tvb, offset, length, hf_msg_block_transactions8, hf_msg_block_transactions16,
-                  hf_msg_block_transactions32, hf_msg_block_transactions64);
+/**
+ * Make room for one more header in both the entry array and the index
+ */
+static void
+bitcoin_chain_reserve(void)
+{
+  guint32 i;
 
-  offset += length;
+  if (header_chain.num_entries == header_chain.max_entries)
+  {
+    header_chain.max_entries = header_chain.max_entries ? header_chain.max_entries * 2 : 4096;
+    header_chain.entries = g_renew(bitcoin_chain_entry_t, header_chain.entries, header_chain.max_entries);
+  }
 
-  msgnum = 0;
-  for (; count > 0; count--)
+  /* keep the load factor of the index below 3/4 */
+  if ((header_chain.num_entries + 1) * 4 > header_chain.index_size * 3)
   {
-    msgnum += 1;
-    offset = dissect_bitcoin_msg_tx_common(tvb, offset, pinfo, tree, msgnum);
+    g_free(header_chain.index);
+    header_chain.index_size = header_chain.index_size ? header_chain.index_size * 2 : 8192;
+    header_chain.index = g_new0(guint32, header_chain.index_size);
+
+    for (i = 0; i < header_chain.num_entries; i++)
+      *bitcoin_chain_find_slot(header_chain.index, header_chain.index_size,
+                               header_chain.entries[i].hash) = i + 1;
   }
 }
-/*
- * Handler for ping messages
+
+/**
+ * The fragment waiting for a missing parent header, created if none is
  */
-static void
-dissect_bitcoin_msg_ping(tvbuff_t *tvb, packet_info *pinfo _U_, proto_tree *tree)
+static guint32
+bitcoin_chain_fragment(guint64 prev)
 {
-  proto_item *ti;
-  guint32     offset = 0;
+  bitcoin_chain_fragment_t *fragment;
+  guint64                  *key;
+  gpointer                  num;
 
-  if (!tree)
-    return;
+  num = g_hash_table_lookup(header_chain.waiting, &prev);
+  if (num)
+    return GPOINTER_TO_UINT(num) - 1;
 
-  ti   = proto_tree_add_item(tree, hf_bitcoin_msg_ping, tvb, offset, -1, ENC_NA);
-  tree = proto_item_add_subtree(ti, ett_ping);
+  if (header_chain.num_fragments == header_chain.max_fragments)
+  {
+    header_chain.max_fragments = header_chain.max_fragments ? header_chain.max_fragments * 2 : 64;
+    header_chain.fragments = g_renew(bitcoin_chain_fragment_t, header_chain.fragments, header_chain.max_fragments);
+  }
 
-  proto_tree_add_item(tree, hf_msg_ping_nonce, tvb, offset, 8, ENC_LITTLE_ENDIAN);
-  offset += 8;
+  fragment = &header_chain.fragments[header_chain.num_fragments];
+  memset(fragment, 0, sizeof(*fragment));
 
+  key  = g_new(guint64, 1);
+  *key = prev;
+  g_hash_table_insert(header_chain.waiting, key, GUINT_TO_POINTER(header_chain.num_fragments + 1));
+
+  return header_chain.num_fragments++;
 }
 
-/*
- * Handler for pong messages
+/**
+ * The fragment at the top of the tree a fragment hangs in
  */
-static void
-dissect_bitcoin_msg_pong(tvbuff_t *tvb, packet_info *pinfo _U_, proto_tree *tree)
+static guint32
+bitcoin_chain_root(guint32 fragment)
 {
-  proto_item *ti;
-  guint32     offset = 0;
+  while (header_chain.fragments[fragment].parent)
+    fragment = header_chain.fragments[fragment].parent - 1;
 
-  if (!tree)
-    return;
+  return fragment;
+}
 
-  ti   = proto_tree_add_item(tree, hf_bitcoin_msg_pong, tvb, offset, -1, ENC_NA);
-  tree = proto_item_add_subtree(ti, ett_pong);
+/**
+ * Chain work of an entry, counted from the top of its fragment tree
+ */
+static gfloat
+bitcoin_chain_work(const bitcoin_chain_entry_t *entry)
+{
+  guint32 fragment = entry->fragment;
+  gfloat  work = entry->work;
 
-  proto_tree_add_item(tree, hf_msg_pong_nonce, tvb, offset, 8, ENC_LITTLE_ENDIAN);
-  offset += 8;
+  while (header_chain.fragments[fragment].parent)
+  {
+    work    += header_chain.fragments[fragment].offset;
+    fragment = header_chain.fragments[fragment].parent - 1;
+  }
 
+  return work;
 }
 
-/*
- * Handler for reject messages
+/**
+ * Offer an entry with the given work, counted from fragment, as the best
+ * of that fragment and of the ones it hangs below
  */
 static void
-dissect_bitcoin_msg_reject(tvbuff_t *tvb, packet_info *pinfo _U_, proto_tree *tree)
+bitcoin_chain_offer(guint32 num, guint32 fragment, gfloat work)
 {
-  proto_item *ti;
-  guint32     offset = 0;
-  gint        varint_length;
-  guint64     str_length;
-  //guint8      error_code;
-
-  if (!tree)
-    return;
-
-  ti   = proto_tree_add_item(tree, hf_bitcoin_msg_reject, tvb, offset, -1, ENC_NA);
-  tree = proto_item_add_subtree(ti, ett_reject);
+  bitcoin_chain_fragment_t *f;
 
-  /* find var_str user_agent */
-
-  get_varint(tvb, offset, &varint_length, &str_length);
-  offset += varint_length;
+  for (;;)
+  {
+    f = &header_chain.fragments[fragment];
+    if (work > f->best_work)
+    {
+      f->best      = num;
+      f->best_work = work;
+    }
+    if (!f->parent)
+      return;
+    work    += f->offset;
+    fragment = f->parent - 1;
+  }
+}
 
-  proto_tree_add_item(tree, hf_msg_reject_command, tvb, offset, str_length, ENC_ASCII|ENC_NA);
-  offset += str_length;
+/**
+ * Make an entry the best tip, moving the main chain flag over from the
+ * old branch; a switch that disconnects blocks is recorded as a reorg
+ * in the frame
+ */
+static void
+bitcoin_chain_set_tip(guint32 num, packet_info *pinfo)
+{
+  bitcoin_chain_entry_t *entry;
+  bitcoin_chain_entry_t *fork;
+  bitcoin_frame_info_t  *frame_info;
+  guint32                depth = 0;
+
+  /* find the first block of the new branch already on the best chain; a
+   * branch that doesn't get there can't be told apart from the best one,
+   * which keeps its flags
+   */
+  for (entry = &header_chain.entries[num]; entry && !(entry->flags & BITCOIN_CHAIN_MAIN);
+       entry = bitcoin_chain_lookup(entry->prev))
+    ;
+  fork = entry;
+  if (!fork && header_chain.tip)
+    return;
 
-  //error_code = tvb_get_guint8(tvb, offset);
-  proto_tree_add_item(tree, hf_msg_reject_code, tvb, offset, 1, ENC_LITTLE_ENDIAN);
-  offset ++;
+  /* connect the new branch up to there */
+  for (entry = &header_chain.entries[num]; entry != fork; entry = bitcoin_chain_lookup(entry->prev))
+    entry->flags |= BITCOIN_CHAIN_MAIN;
 
-  get_varint(tvb, offset, &varint_length, &str_length);
-  offset += varint_length;
+  /* and disconnect the old branch down to there */
+  if (header_chain.tip)
+  {
+    for (entry = &header_chain.entries[header_chain.tip - 1]; entry && entry != fork;
+         entry = bitcoin_chain_lookup(entry->prev))
+    {
+      entry->flags &= ~BITCOIN_CHAIN_MAIN;
+      depth++;
+    }
+  }
 
-  proto_tree_add_item(tree, hf_msg_reject_reason, tvb, offset, str_length, ENC_ASCII|ENC_NA);
-  offset += str_length;
+  header_chain.tip = num + 1;
 
-  proto_tree_add_item(tree, hf_msg_reject_hash, tvb, offset, 32, ENC_NA);
-  offset += 32;
+  if (fork && depth > 0)
+  {
+    frame_info = get_bitcoin_frame_info(pinfo, TRUE);
+    frame_info->reorg_hash       = header_chain.entries[num].hash;
+    frame_info->reorg_depth      = depth;
+    frame_info->reorg_fork_frame = fork->frame;
+  }
 }
 
-/*
- * Handler for alert messages
+/**
+ * Add a block header to the chain; the first frame a header is seen in wins
  */
 static void
-dissect_bitcoin_msg_alert(tvbuff_t *tvb, packet_info *pinfo _U_, proto_tree *tree)
+bitcoin_chain_add(tvbuff_t *tvb, gint offset, const guint8 *hash, guint32 height, packet_info *pinfo)
 {
-  proto_item *ti;
-  guint32     offset = 0;
-  gint        varint_length;
-  guint64     msg_length,sig_length,set_length,str_length;
-  proto_tree  *subtree;
+  bitcoin_chain_entry_t *entry;
+  bitcoin_chain_entry_t *parent;
+  guint64                key = pletoh64(hash);
+  guint32                num;
+  gpointer               waiting;
+  static const guint8    null_hash[32] = { 0 };
+
+  entry = bitcoin_chain_lookup(key);
+  if (entry)
+  {
+    /* a block message can tell the height of a header seen before */
+    if (entry->height == BITCOIN_HEIGHT_UNKNOWN)
+      entry->height = height;
+    return;
+  }
 
-  if (!tree)
+  /* the entries and, at worst, twice as many index slots */
+  if (bitcoin_state_budget &&
+      (guint64)(header_chain.num_entries + 1) * (sizeof(bitcoin_chain_entry_t) + 2 * sizeof(guint32)) >
+      (guint64)bitcoin_state_budget * 1024 * 1024)
+  {
+    bitcoin_state_dropped(BITCOIN_STATE_CHAIN, 1, pinfo);
     return;
+  }
 
-  ti   = proto_tree_add_item(tree, hf_bitcoin_msg_alert, tvb, offset, -1, ENC_NA);
-  tree = proto_item_add_subtree(ti, ett_alert);
+  bitcoin_chain_reserve();
 
-  /* message portion*/
-  get_varint(tvb, offset, &varint_length, &msg_length);
+  entry = &header_chain.entries[header_chain.num_entries];
+  entry->hash   = key;
+  entry->prev   = tvb_get_letoh64(tvb, offset + 4);
+  entry->work   = bitcoin_block_work(tvb_get_letohl(tvb, offset + 72));
+  entry->height = height;
+  entry->frame  = pinfo->fd->num;
+  entry->flags  = 0;
 
-  ti   = proto_tree_add_item(tree, hf_msg_alert_message, tvb, offset, varint_length+msg_length, ENC_NA);
-  subtree = proto_item_add_subtree(ti, ett_alert_message);
+  parent = bitcoin_chain_lookup(entry->prev);
+  if (parent)
+  {
+    entry->fragment = parent->fragment;
+    entry->work    += parent->work;
+    if (parent->height != BITCOIN_HEIGHT_UNKNOWN)
+      entry->height = parent->height + 1;
+    if (parent->flags & BITCOIN_CHAIN_HAS_CHILD)
+      entry->flags |= BITCOIN_CHAIN_FORK;
+    parent->flags |= BITCOIN_CHAIN_HAS_CHILD;
+  }
+  else
+  {
+    entry->fragment = bitcoin_chain_fragment(entry->prev);
+    if (tvb_memeql(tvb, offset + 4, null_hash, 32) == 0)
+      entry->height = 0;
+  }
 
-  add_varint_item(subtree, tvb, offset, varint_length, hf_msg_alert_msg_length8, hf_msg_alert_msg_length16,
-                  hf_msg_alert_msg_length32, hf_msg_alert_msg_length64);
-  offset += varint_length;
+  num = header_chain.num_entries;
+  *bitcoin_chain_find_slot(header_chain.index, header_chain.index_size, key) = ++header_chain.num_entries;
+  bitcoin_chain_offer(num, entry->fragment, entry->work);
 
-  // version 
-  proto_tree_add_item(subtree, hf_msg_alert_version,  tvb, offset,  4, ENC_LITTLE_ENDIAN);
-  offset += 4;
+  /* the headers that were waiting for this one now hang below it */
+  waiting = g_hash_table_lookup(header_chain.waiting, &key);
+  if (waiting)
+  {
+    bitcoin_chain_fragment_t *below = &header_chain.fragments[GPOINTER_TO_UINT(waiting) - 1];
+    gboolean                  has_tip;
 
-  // times 
-  proto_tree_add_item(subtree, hf_msg_alert_relayuntil, tvb, offset, 8, ENC_TIME_TIMESPEC|ENC_LITTLE_ENDIAN);
-  offset += 8;
-  proto_tree_add_item(subtree, hf_msg_alert_expiration, tvb, offset, 8, ENC_TIME_TIMESPEC|ENC_LITTLE_ENDIAN);
-  offset += 8;
+    has_tip = header_chain.tip &&
+              bitcoin_chain_root(header_chain.entries[header_chain.tip - 1].fragment) == GPOINTER_TO_UINT(waiting) - 1;
+    g_hash_table_remove(header_chain.waiting, &key);
 
-  // id & cancel 
-  proto_tree_add_item(subtree, hf_msg_alert_id,  tvb, offset,  4, ENC_LITTLE_ENDIAN);
-  offset += 4;
-  proto_tree_add_item(subtree, hf_msg_alert_cancel,  tvb, offset,  4, ENC_LITTLE_ENDIAN);
-  offset += 4;
+    below->parent = entry->fragment + 1;
+    below->offset = entry->work;
+    bitcoin_chain_offer(below->best, entry->fragment, below->best_work + entry->work);
 
-  // cancel set 
-  get_varint(tvb, offset, &varint_length, &set_length);
-  add_varint_item(subtree, tvb, offset, varint_length, hf_msg_alert_cancel_set_count8, hf_msg_alert_cancel_set_count16,
-                  hf_msg_alert_cancel_set_count32, hf_msg_alert_cancel_set_count64);
-  offset += varint_length;
+    /* the ancestors of the best tip are on the best chain */
+    if (has_tip)
+    {
+      bitcoin_chain_entry_t *ancestor;
 
-  for (; set_length > 0; set_length--)
+      for (ancestor = entry; ancestor && !(ancestor->flags & BITCOIN_CHAIN_MAIN);
+           ancestor = bitcoin_chain_lookup(ancestor->prev))
+        ancestor->flags |= BITCOIN_CHAIN_MAIN;
+    }
+  }
+
+  /* a tip can only take over from one whose work counts from the same
+   * first header; an island that doesn't connect yet never does
+   */
+  if (!header_chain.tip)
+    bitcoin_chain_set_tip(num, pinfo);
+  else
   {
-    // **** should put this in a sub list
-    //subtree = proto_item_add_subtree(ti, ett_inv_list);
+    bitcoin_chain_entry_t    *tip = &header_chain.entries[header_chain.tip - 1];
+    bitcoin_chain_fragment_t *root = &header_chain.fragments[bitcoin_chain_root(entry->fragment)];
 
-    proto_tree_add_item(subtree, hf_msg_alert_cancel_set_item, tvb, offset, 4, ENC_LITTLE_ENDIAN);
-    offset += 4;
+    if (root == &header_chain.fragments[bitcoin_chain_root(tip->fragment)] &&
+        root->best != header_chain.tip - 1 && root->best_work > bitcoin_chain_work(tip))
+      bitcoin_chain_set_tip(root->best, pinfo);
   }
+}
 
-  proto_tree_add_item(subtree, hf_msg_alert_min_version,  tvb, offset,  4, ENC_LITTLE_ENDIAN);
-  offset += 4;
-  proto_tree_add_item(subtree, hf_msg_alert_max_version,  tvb, offset,  4, ENC_LITTLE_ENDIAN);
-  offset += 4;
+/**
+ * Classify an output script by its standard template
+ */
+static guint8
+get_bitcoin_script_type(tvbuff_t *tvb, gint offset, guint64 length)
+{
+  guint8 first;
+  guint8 last;
 
+  if (length == 0 || !tvb_bytes_exist(tvb, offset, (gint)MIN(length, 2)))
+    return SCRIPT_TYPE_NONSTANDARD;
 
-  // subver set 
-  get_varint(tvb, offset, &varint_length, &set_length);
-  add_varint_item(subtree, tvb, offset, varint_length, hf_msg_alert_subver_set_count8, hf_msg_alert_subver_set_count16,
-                  hf_msg_alert_subver_set_count32, hf_msg_alert_subver_set_count64);
-  offset += varint_length;
+  first = tvb_get_guint8(tvb, offset);
+  if (first == 0x6a)
+    return SCRIPT_TYPE_NULL_DATA;
 
-  for (; set_length > 0; set_length--)
+  /* the longest standard template is 3-of-3 bare multisig with uncompressed keys */
+  if (length > 1 + 3 * 66 + 2 || !tvb_bytes_exist(tvb, offset, (gint)length))
+    return SCRIPT_TYPE_NONSTANDARD;
+
+  last = tvb_get_guint8(tvb, offset + (gint)length - 1);
+
+  switch (length)
   {
-    // **** should put this in a sub list
-    //subtree = proto_item_add_subtree(ti, ett_inv_list);
+  case 22:
+    if (first == 0x00 && tvb_get_guint8(tvb, offset+1) == 0x14)
+      return SCRIPT_TYPE_P2WPKH;
+    break;
+  case 23:
+    if (first == 0xa9 && tvb_get_guint8(tvb, offset+1) == 0x14 && last == 0x87)
+      return SCRIPT_TYPE_P2SH;
+    break;
+  case 25:
+    if (tvb_get_ntohs(tvb, offset) == 0x76a9 && tvb_get_guint8(tvb, offset+2) == 0x14 &&
+        tvb_get_guint8(tvb, offset+23) == 0x88 && last == 0xac)
+      return SCRIPT_TYPE_P2PKH;
+    break;
+  case 34:
+    if (first == 0x00 && tvb_get_guint8(tvb, offset+1) == 0x20)
+      return SCRIPT_TYPE_P2WSH;
+    if (first == 0x51 && tvb_get_guint8(tvb, offset+1) == 0x20)
+      return SCRIPT_TYPE_P2TR;
+    break;
+  case 35:
+  case 67:
+    if ((first == 0x21 || first == 0x41) && last == 0xac)
+      return SCRIPT_TYPE_P2PK;
+    break;
+  }
 
-    guint64 subver_length;
+  /* OP_m <pubkeys> OP_n OP_CHECKMULTISIG, standard up to n = 3 */
+  if (first >= 0x51 && first <= 0x53 && last == 0xae && length >= 37)
+  {
+    guint8 n = tvb_get_guint8(tvb, offset + (gint)length - 2);
 
-    get_varint(tvb, offset, &varint_length, &subver_length);
-    add_varint_item(subtree, tvb, offset, varint_length,hf_msg_alert_subver_set_str_length8, 
-                          hf_msg_alert_subver_set_str_length16, 
-                          hf_msg_alert_subver_set_str_length32,hf_msg_alert_subver_set_str_length64); 
-    offset += varint_length;
+    if (n >= first && n <= 0x53)
+      return SCRIPT_TYPE_MULTISIG;
+  }
 
-    proto_tree_add_item(subtree,hf_msg_alert_subver_set_string, tvb, offset, subver_length, ENC_ASCII|ENC_NA);
-    offset += subver_length;
+  return SCRIPT_TYPE_NONSTANDARD;
+}
+
+/**
+ * 64 bit FNV-1a, used for the compact keys of the capture-wide tables
+ */
+static guint64
+bitcoin_hash64(guint64 hash, const guint8 *data, gsize length)
+{
+  gsize i;
 
+  for (i = 0; i < length; i++)
+  {
+    hash ^= data[i];
+    hash *= G_GUINT64_CONSTANT(0x100000001b3);
   }
 
-  // priority
+  return hash;
+}
 
-  proto_tree_add_item(subtree, hf_msg_alert_priority,  tvb, offset,  4, ENC_LITTLE_ENDIAN);
-  offset += 4;
+#define BITCOIN_HASH64_INIT G_GUINT64_CONSTANT(0xcbf29ce484222325)
 
-  // string messages -- comment
-    get_varint(tvb, offset, &varint_length, &str_length);
-    add_varint_item(subtree, tvb, offset, varint_length,hf_msg_alert_str_comment_length8, 
-                          hf_msg_alert_str_comment_length16, 
-                          hf_msg_alert_str_comment_length32,hf_msg_alert_str_comment_length64); 
-    offset += varint_length;
+/**
+ * Record a gossiped address and add the generated fields describing it
+ */
+static void
+bitcoin_track_addr(tvbuff_t *tvb, gint offset, gint length, packet_info *pinfo, proto_tree *tree,
+                   guint8 network, const guint8 *addr, gsize addr_length, guint16 port,
+                   guint64 services, bitcoin_tap_addr_t *tap_addr)
+{
+  bitcoin_addr_info_t  *addr_info;
+  bitcoin_addr_relay_t *relay;
+  proto_item           *ti;
+  guint64               key;
+  guint64               relay_key;
 
-    proto_tree_add_item(subtree,hf_msg_alert_str_comment, tvb, offset, str_length, ENC_ASCII|ENC_NA);
-    offset += str_length;
+  key = bitcoin_hash64(BITCOIN_HASH64_INIT, &network, 1);
+  key = bitcoin_hash64(key, addr, addr_length);
+  key = bitcoin_hash64(key, (const guint8 *)&port, sizeof(port));
 
-  // string messages -- status bar
-    get_varint(tvb, offset, &varint_length, &str_length);
-    add_varint_item(subtree, tvb, offset, varint_length,hf_msg_alert_str_status_bar_length8, 
-                          hf_msg_alert_str_status_bar_length16, 
-                          hf_msg_alert_str_status_bar_length32,hf_msg_alert_str_status_bar_length64); 
-    offset += varint_length;
+  /* the relaying peer is identified by its address, not the connection */
+  relay_key = bitcoin_hash64(key, (const guint8 *)pinfo->src.data, pinfo->src.len);
 
-    proto_tree_add_item(subtree,hf_msg_alert_str_status_bar, tvb, offset, str_length, ENC_ASCII|ENC_NA);
-    offset += str_length;
+  addr_info = (bitcoin_addr_info_t *)g_hash_table_lookup(addr_table, &key);
+  relay     = (bitcoin_addr_relay_t *)g_hash_table_lookup(addr_relay_table, &relay_key);
+
+  if (!pinfo->fd->flags.visited)
+  {
+    if (!addr_info)
+    {
+      addr_info = g_new0(bitcoin_addr_info_t, 1);
+      addr_info->key         = key;
+      addr_info->network     = network;
+      addr_info->first_frame = pinfo->fd->num;
+      bitcoin_budget_insert(BITCOIN_STATE_ADDR, &addr_info->key, addr_info, pinfo);
+    }
+    addr_info->services  = services;
+    addr_info->last_frame = pinfo->fd->num;
+    addr_info->sightings++;
+
+    if (!relay)
+    {
+      relay = g_new(bitcoin_addr_relay_t, 1);
+      relay->key         = relay_key;
+      relay->first_frame = pinfo->fd->num;
+      bitcoin_budget_insert(BITCOIN_STATE_ADDR_RELAY, &relay->key, relay, pinfo);
+      addr_info->peers++;
+    }
+  }
+
+  /* evicted, and seen again only later in the capture */
+  if (!addr_info || addr_info->first_frame > pinfo->fd->num)
+    return;
+
+  if (tap_addr)
+  {
+    tap_addr->network   = network;
+    tap_addr->is_new    = addr_info->first_frame == pinfo->fd->num;
+    tap_addr->new_relay = relay && relay->first_frame == pinfo->fd->num;
+  }
+
+  ti = proto_tree_add_uint(tree, hf_addr_first_frame, tvb, offset, length, addr_info->first_frame);
+  PROTO_ITEM_SET_GENERATED(ti);
+  ti = proto_tree_add_uint(tree, hf_addr_last_frame, tvb, offset, length, addr_info->last_frame);
+  PROTO_ITEM_SET_GENERATED(ti);
+  ti = proto_tree_add_uint(tree, hf_addr_peers, tvb, offset, length, addr_info->peers);
+  PROTO_ITEM_SET_GENERATED(ti);
+  ti = proto_tree_add_uint(tree, hf_addr_sightings, tvb, offset, length, addr_info->sightings);
+  PROTO_ITEM_SET_GENERATED(ti);
+}
+
+/**
+ * Queue the addresses of an addr or addrv2 message to the tap
+ */
+static void
+bitcoin_tap_queue_addrs(packet_info *pinfo, bitcoin_tap_addr_t *addrs, guint count)
+{
+  bitcoin_tap_info_t *tap_info;
+
+  tap_info = ep_new0(bitcoin_tap_info_t);
+  tap_info->type       = BITCOIN_TAP_ADDR;
+  tap_info->addr_count = count;
+  tap_info->addrs      = addrs;
+  tap_queue_packet(bitcoin_tap, pinfo, tap_info);
+}
+
+/**
+ * Create a services sub-tree for bit-by-bit display
+ */
+static proto_tree *
+create_services_tree(tvbuff_t *tvb, proto_item *ti, guint32 offset)
+{
+  proto_tree *tree;
+  guint64 services;
+
+  tree = proto_item_add_subtree(ti, ett_services);
+
+  /* start of services */
+  /* NOTE:
+   *  - 2011-06-05
+   *    Currently the boolean tree only supports a maximum of
+   *    32 bits - so we split services in two
+   */
+  services = tvb_get_letoh64(tvb, offset);
+
+  /* service = NODE_NETWORK */
+  proto_tree_add_boolean(tree, hf_services_network, tvb, offset, 4, (guint32)services);
+
+  /* end of services */
+
+  return tree;
+}
+
+/**
+ * Create a sub-tree and fill it with a net_addr structure
+ */
+static proto_tree *
+create_address_tree(tvbuff_t *tvb, proto_item *ti, guint32 offset)
+{
+  proto_tree *tree;
+
+  tree = proto_item_add_subtree(ti, ett_address);
+
+  /* services */
+  ti = proto_tree_add_item(tree, hf_address_services, tvb, offset, 8, ENC_LITTLE_ENDIAN);
+  create_services_tree(tvb, ti, offset);
+  offset += 8;
+
+  /* IPv6 address */
+  proto_tree_add_item(tree, hf_address_address, tvb, offset, 16, ENC_NA);
+  offset += 16;
+
+  /* port */
+  proto_tree_add_item(tree, hf_address_port, tvb, offset, 2, ENC_BIG_ENDIAN);
+
+  return tree;
+}
+
+/**
+ * Extract a variable length integer from a tvbuff
+ */
+static void
+get_varint(tvbuff_t *tvb, const gint offset, gint *length, guint64 *ret)
+{
+  guint value;
+
+  /* Note: just throw an exception if not enough  bytes are available in the tvbuff */
+
+  /* calculate variable length */
+  value = tvb_get_guint8(tvb, offset);
+  if (value < 0xfd)
+  {
+    *length = 1;
+    *ret = value;
+    return;
+  }
+
+  if (value == 0xfd)
+  {
+    *length = 3;
+    *ret = tvb_get_letohs(tvb, offset+1);
+    return;
+  }
+  if (value == 0xfe)
+  {
+    *length = 5;
+    *ret = tvb_get_letohl(tvb, offset+1);
+    return;
+  }
+
+  *length = 9;
+  *ret = tvb_get_letoh64(tvb, offset+1);
+  return;
+
+}
+
+/**
+ * Add a variable length integer that was already decoded by get_varint(),
+ * so the bytes aren't fetched from the tvbuff a second time
+ */
+static void add_varint_item(proto_tree *tree, tvbuff_t *tvb, const gint offset, gint length, guint64 value,
+                            gint hf8, gint hf16, gint hf32, gint hf64)
+{
+  switch (length)
+  {
+  case 1:
+    proto_tree_add_uint(tree, hf8,  tvb, offset, 1, (guint32)value);
+    break;
+  case 3:
+    proto_tree_add_uint(tree, hf16, tvb, offset+1, 2, (guint32)value);
+    break;
+  case 5:
+    proto_tree_add_uint(tree, hf32, tvb, offset+1, 4, (guint32)value);
+    break;
+  case 9:
+    proto_tree_add_uint64(tree, hf64, tvb, offset+1, 8, value);
+    break;
+  }
+}
+
+/**
+ * Add a 32 byte hash, already fetched from the wire, with its bytes in
+ * display order
+ */
+static proto_item *
+add_hash_item_ptr(proto_tree *tree, tvbuff_t *tvb, const gint offset, gint hfindex, const guint8 *hash)
+{
+  guint8 reversed[32];
+
+  if (!tree)
+    return NULL;
+
+  bitcoin_hash_reverse(hash, reversed);
+  return proto_tree_add_bytes(tree, hfindex, tvb, offset, 32, reversed);
+}
+
+/**
+ * Add a 32 byte hash from the wire with its bytes in display order
+ */
+static proto_item *
+add_hash_item(proto_tree *tree, tvbuff_t *tvb, const gint offset, gint hfindex)
+{
+  if (!tree)
+    return NULL;
+
+  return add_hash_item_ptr(tree, tvb, offset, hfindex, tvb_get_ptr(tvb, offset, 32));
+}
+
+/**
+ * Like get_varint() but returns FALSE instead of throwing when the
+ * varint isn't complete in the tvbuff
+ */
+static gboolean
+try_get_varint(tvbuff_t *tvb, const gint offset, gint *length, guint64 *ret)
+{
+  guint value;
+  gint  needed;
+
+  if (!tvb_bytes_exist(tvb, offset, 1))
+    return FALSE;
+
+  value = tvb_get_guint8(tvb, offset);
+  if (value < 0xfd)
+    needed = 1;
+  else if (value == 0xfd)
+    needed = 3;
+  else if (value == 0xfe)
+    needed = 5;
+  else
+    needed = 9;
+
+  if (!tvb_bytes_exist(tvb, offset, needed))
+    return FALSE;
+
+  get_varint(tvb, offset, length, ret);
+  return TRUE;
+}
+
+/**
+ * Read a variable length integer at *pos of a buffer of length bytes
+ * fetched from the tvbuff, advancing *pos; FALSE if it runs past the end
+ */
+static gboolean
+bitcoin_ptr_varint(const guint8 *data, guint32 length, guint32 *pos, guint64 *ret)
+{
+  guint32 needed;
+
+  if (*pos >= length)
+    return FALSE;
+
+  switch (data[*pos])
+  {
+  case 0xfd: needed = 3; break;
+  case 0xfe: needed = 5; break;
+  case 0xff: needed = 9; break;
+  default:   needed = 1; break;
+  }
+  if (needed > length - *pos)
+    return FALSE;
+
+  switch (needed)
+  {
+  case 1:  *ret = data[*pos]; break;
+  case 3:  *ret = pletohs(data + *pos + 1); break;
+  case 5:  *ret = pletohl(data + *pos + 1); break;
+  default: *ret = pletoh64(data + *pos + 1); break;
+  }
+  *pos += needed;
+
+  return TRUE;
+}
+
+/**
+ * Advance *pos over count bytes of a buffer of length bytes; FALSE if that
+ * runs past the end
+ */
+static gboolean
+bitcoin_ptr_skip(guint32 length, guint32 *pos, guint64 count)
+{
+  if (*pos > length || count > length - *pos)
+    return FALSE;
+  *pos += (guint32)count;
+
+  return TRUE;
+}
+
+/**
+ * Walk a serialized transaction in a buffer without dissecting it
+ *
+ * Returns the length of the transaction at the start of the buffer, or 0
+ * if it isn't complete in it. A BIP 144 serialization has a 0x00 marker
+ * and a 0x01 flag after the version, where the input count would be (a tx
+ * without inputs is invalid), and a witness stack per input after the
+ * outputs.
+ */
+static guint32
+get_bitcoin_tx_layout_ptr(const guint8 *data, guint32 length, bitcoin_tx_layout_t *layout)
+{
+  guint64  count;
+  guint64  in_count;
+  guint64  item_count;
+  guint64  script_length;
+  gboolean segwit = FALSE;
+  guint32  pos = 0;
+
+  layout->length  = 0;
+  layout->witness = 0;
+
+  /* version, marker and flag, TxIn[] */
+  if (!bitcoin_ptr_skip(length, &pos, 4))
+    return 0;
+
+  if (length - pos >= 2 && data[pos] == 0x00 && data[pos + 1] == 0x01)
+  {
+    segwit = TRUE;
+    pos   += 2;
+  }
+
+  if (!bitcoin_ptr_varint(data, length, &pos, &in_count))
+    return 0;
+
+  for (count = in_count; count > 0; count--)
+  {
+    if (!bitcoin_ptr_skip(length, &pos, 36) || !bitcoin_ptr_varint(data, length, &pos, &script_length) ||
+        !bitcoin_ptr_skip(length, &pos, script_length) || !bitcoin_ptr_skip(length, &pos, 4))
+      return 0;
+  }
+
+  /* TxOut[] */
+  if (!bitcoin_ptr_varint(data, length, &pos, &count))
+    return 0;
+
+  for (; count > 0; count--)
+  {
+    if (!bitcoin_ptr_skip(length, &pos, 8) || !bitcoin_ptr_varint(data, length, &pos, &script_length) ||
+        !bitcoin_ptr_skip(length, &pos, script_length))
+      return 0;
+  }
+
+  /* one witness stack per input */
+  if (segwit)
+  {
+    layout->witness = pos;
+
+    for (count = in_count; count > 0; count--)
+    {
+      if (!bitcoin_ptr_varint(data, length, &pos, &item_count))
+        return 0;
+
+      for (; item_count > 0; item_count--)
+      {
+        if (!bitcoin_ptr_varint(data, length, &pos, &script_length) ||
+            !bitcoin_ptr_skip(length, &pos, script_length))
+          return 0;
+      }
+    }
+  }
+
+  /* lock time */
+  if (!bitcoin_ptr_skip(length, &pos, 4))
+    return 0;
+
+  layout->length = pos;
+
+  return pos;
+}
+
+/**
+ * Walk the transaction starting at offset; its length, or 0 if it isn't
+ * complete in the tvbuff
+ */
+static guint32
+get_bitcoin_tx_layout(tvbuff_t *tvb, guint32 offset, bitcoin_tx_layout_t *layout)
+{
+  gint available = tvb_length_remaining(tvb, offset);
+
+  layout->length  = 0;
+  layout->witness = 0;
+
+  if (available <= 0)
+    return 0;
+
+  return get_bitcoin_tx_layout_ptr(tvb_get_ptr(tvb, offset, available), available, layout);
+}
+
+/**
+ * Length of the transaction starting at offset, or 0 if it isn't complete
+ * in the tvbuff
+ */
+static guint32
+get_bitcoin_tx_length(tvbuff_t *tvb, guint32 offset)
+{
+  bitcoin_tx_layout_t layout;
+
+  return get_bitcoin_tx_layout(tvb, offset, &layout);
+}
+
+/**
+ * Size of a tx without its marker, flag and witness, as the txid hashes it
+ */
+static guint32
+get_bitcoin_tx_stripped_size(const bitcoin_tx_layout_t *layout)
+{
+  if (!layout->witness)
+    return layout->length;
+
+  /* version, inputs and outputs, lock time */
+  return 4 + (layout->witness - 6) + 4;
+}
+
+/**
+ * Compute the txid of a walked tx, which doesn't commit to the witness
+ */
+static void
+get_bitcoin_txid(tvbuff_t *tvb, guint32 offset, const bitcoin_tx_layout_t *layout, guint8 *txid)
+{
+  guint32 parts[6];
+
+  if (!layout->witness)
+  {
+    get_bitcoin_hash(tvb, offset, layout->length, txid);
+    return;
+  }
+
+  parts[0] = 0;
+  parts[1] = 4;
+  parts[2] = 6;
+  parts[3] = layout->witness - 6;
+  parts[4] = layout->length - 4;
+  parts[5] = 4;
+  get_bitcoin_hash_parts(tvb, offset, parts, 3, TRUE, txid);
+}
+
+/**
+ * Compute the wtxid of a walked tx, the hash of the whole serialization;
+ * not cached, as it shares its position with the txid
+ */
+static void
+get_bitcoin_wtxid(tvbuff_t *tvb, guint32 offset, const bitcoin_tx_layout_t *layout, guint8 *wtxid)
+{
+  guint32 parts[2];
+
+  parts[0] = 0;
+  parts[1] = layout->length;
+  get_bitcoin_hash_parts(tvb, offset, parts, 1, FALSE, wtxid);
+}
+
+/* Note: A number of the following message handlers include code of the form:
+ *          ...
+ *          guint64     count;
+ *          ...
+ *          for (; count > 0; count--)
+ *          {
+ *            proto_tree_add_item9...);
+ *            offset += ...;
+ *            proto_tree_add_item9...);
+ *            offset += ...;
+ *            ...
+ *          }
+ *          ...
+ *
+ * Issue if 'count' is a very large number:
+ *    If 'tree' is NULL, then the result will be effectively (but not really)
+ *    an infinite loop. This is true because if 'tree' is NULL then
+ *    proto_tree_add_item(tree, ...) is effectively a no-op and will not throw
+ *    an exception.
+ *    So: the loop should be executed only when 'tree' is defined so that the
+ *        proto_ calls will throw an exception when the tvb is used up;
+ *        This should only take a few-hundred loops at most.
+ *           https://bugs.wireshark.org/bugzilla/show_bug.cgi?id=8312
+ */
+
+/**
+ * Handler for version messages
+ */
+static void
+dissect_bitcoin_msg_version(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
+{
+  proto_item                     *ti;
+  gint                            varint_length;
+  guint64                         user_agent_length;
+  guint32                         offset = 0;
+  guint32                         version;
+  bitcoin_conv_info_t            *conv_info;
+  guint                           direction;
+  const bitcoin_version_layout_t *layout;
+
+  version   = tvb_get_letohl(tvb, offset);
+  conv_info = get_bitcoin_conv_info(pinfo);
+  direction = get_bitcoin_direction(conv_info, pinfo);
+
+  /* the connection uses the lower of the two versions */
+  if (!pinfo->fd->flags.visited)
+  {
+    guint32 other = conv_info->version[1 - direction];
+
+    conv_info->version[direction] = version;
+    conv_info->layout = get_bitcoin_version_layout(other && other < version ? other : version);
+  }
+
+  if (!tree)
+    return;
+
+  /* the message itself is laid out for the sender's version */
+  layout = get_bitcoin_version_layout(version);
+
+  ti   = proto_tree_add_item(tree, hf_bitcoin_msg_version, tvb, offset, -1, ENC_NA);
+  tree = proto_item_add_subtree(ti, ett_bitcoin_msg);
+
+  proto_tree_add_item(tree, hf_msg_version_version, tvb, offset, 4, ENC_LITTLE_ENDIAN);
+  offset += 4;
+
+  if (conv_info->version[0] && conv_info->version[1])
+  {
+    ti = proto_tree_add_uint(tree, hf_msg_version_negotiated, tvb, 0, 4,
+                             MIN(conv_info->version[0], conv_info->version[1]));
+    PROTO_ITEM_SET_GENERATED(ti);
+  }
+
+  ti = proto_tree_add_item(tree, hf_msg_version_services, tvb, offset, 8, ENC_LITTLE_ENDIAN);
+  create_services_tree(tvb, ti, offset);
+  offset += 8;
+
+  proto_tree_add_item(tree, hf_msg_version_timestamp, tvb, offset, 8, ENC_TIME_TIMESPEC|ENC_LITTLE_ENDIAN);
+  offset += 8;
+
+  ti = proto_tree_add_item(tree, hf_msg_version_addr_me, tvb, offset, 26, ENC_NA);
+  create_address_tree(tvb, ti, offset);
+  offset += 26;
+
+  if (!layout->addr_from)
+    return;
+
+  ti = proto_tree_add_item(tree, hf_msg_version_addr_you, tvb, offset, 26, ENC_NA);
+  create_address_tree(tvb, ti, offset);
+  offset += 26;
+
+  proto_tree_add_item(tree, hf_msg_version_nonce, tvb, offset, 8, ENC_LITTLE_ENDIAN);
+  offset += 8;
+
+  /* find var_str user_agent */
+
+  get_varint(tvb, offset, &varint_length, &user_agent_length);
+  add_varint_item(tree, tvb, offset, varint_length, user_agent_length, hf_msg_version_user_agent_length8, hf_msg_version_user_agent_length16,
+                  hf_msg_version_user_agent_length32, hf_msg_version_user_agent_length64);
+  offset += varint_length;
+
+  proto_tree_add_item(tree, hf_msg_version_user_agent, tvb, offset, user_agent_length, ENC_ASCII|ENC_NA);
+  offset += user_agent_length;
+
+  if (!layout->start_height)
+    return;
+
+  proto_tree_add_item(tree, hf_msg_version_start_height, tvb, offset, 4, ENC_LITTLE_ENDIAN);
+  offset += 4;
+
+  /* optional even for versions that know it */
+  if (layout->relay && tvb_length_remaining(tvb, offset) > 0)
+    proto_tree_add_item(tree, hf_msg_version_relay, tvb, offset, 1, ENC_LITTLE_ENDIAN);
+}
+
+/*
+ * Handler for address messages
+ */
+static void
+dissect_bitcoin_msg_addr(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
+{
+  proto_item         *ti;
+  gint                length;
+  guint64             count;
+  guint32             offset = 0;
+  bitcoin_tap_addr_t *tap_addrs = NULL;
+  guint               tap_count = 0;
+  gint                time_length;
+  gint                entry_length;
+
+  if (!tree && !bitcoin_addr_tracking)
+    return;
+
+  /* entries have no timestamp before version 31402 */
+  time_length  = get_bitcoin_conv_layout(pinfo)->addr_time ? 4 : 0;
+  entry_length = time_length + 26;
+
+  ti   = proto_tree_add_item(tree, hf_bitcoin_msg_addr, tvb, offset, -1, ENC_NA);
+  tree = proto_item_add_subtree(ti, ett_bitcoin_msg);
+
+  get_varint(tvb, offset, &length, &count);
+  add_varint_item(tree, tvb, offset, length, count, hf_msg_addr_count8, hf_msg_addr_count16,
+                  hf_msg_addr_count32, hf_msg_addr_count64);
+  offset += length;
+
+  if (bitcoin_addr_tracking && have_tap_listener(bitcoin_tap))
+    tap_addrs = (bitcoin_tap_addr_t *)ep_alloc0(sizeof(bitcoin_tap_addr_t) *
+                                                (MIN(count, (guint64)tvb_length_remaining(tvb, offset) / entry_length) + 1));
+
+  for (; count > 0; count--)
+  {
+    proto_tree *subtree;
+
+    ti = proto_tree_add_item(tree, hf_msg_addr_address, tvb, offset, entry_length, ENC_NA);
+    subtree = create_address_tree(tvb, ti, offset+time_length);
+
+    if (time_length)
+      proto_tree_add_item(subtree, hf_msg_addr_timestamp, tvb, offset, 4, ENC_TIME_TIMESPEC|ENC_LITTLE_ENDIAN);
+
+    if (bitcoin_addr_tracking)
+    {
+      static const guint8 ipv4_mapped[12] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff };
+      const guint8 *addr = tvb_get_ptr(tvb, offset+time_length+8, 16);
+      guint16       port = tvb_get_ntohs(tvb, offset+time_length+24);
+      guint64       services = tvb_get_letoh64(tvb, offset+time_length);
+
+      /* key legacy entries the way the equivalent addrv2 entry would be */
+      if (memcmp(addr, ipv4_mapped, sizeof(ipv4_mapped)) == 0)
+        bitcoin_track_addr(tvb, offset, entry_length, pinfo, subtree, ADDRV2_NET_IPV4, addr+12, 4, port, services,
+                           tap_addrs ? &tap_addrs[tap_count++] : NULL);
+      else
+        bitcoin_track_addr(tvb, offset, entry_length, pinfo, subtree, ADDRV2_NET_IPV6, addr, 16, port, services,
+                           tap_addrs ? &tap_addrs[tap_count++] : NULL);
+    }
+
+    offset += entry_length;
+  }
+
+  if (tap_addrs)
+    bitcoin_tap_queue_addrs(pinfo, tap_addrs, tap_count);
+}
+
+/*
+ * Handler for addrv2 messages (BIP155)
+ */
+static void
+dissect_bitcoin_msg_addrv2(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
+{
+  proto_item         *ti;
+  gint                length;
+  guint64             count;
+  guint32             offset = 0;
+  bitcoin_tap_addr_t *tap_addrs = NULL;
+  guint               tap_count = 0;
+
+  if (!tree && !bitcoin_addr_tracking)
+    return;
+
+  ti   = proto_tree_add_item(tree, hf_bitcoin_msg_addrv2, tvb, offset, -1, ENC_NA);
+  tree = proto_item_add_subtree(ti, ett_bitcoin_msg);
+
+  get_varint(tvb, offset, &length, &count);
+  add_varint_item(tree, tvb, offset, length, count, hf_msg_addrv2_count8, hf_msg_addrv2_count16,
+                  hf_msg_addrv2_count32, hf_msg_addrv2_count64);
+  offset += length;
+
+  /* the smallest entry is 9 bytes long */
+  if (bitcoin_addr_tracking && have_tap_listener(bitcoin_tap))
+    tap_addrs = (bitcoin_tap_addr_t *)ep_alloc0(sizeof(bitcoin_tap_addr_t) *
+                                                (MIN(count, (guint64)tvb_length_remaining(tvb, offset) / 9) + 1));
+
+  /*  Address
+   *    [ 4] time          uint32_t
+   *    [1+] services      var_int
+   *    [ 1] network id    uint8_t
+   *    [1+] addr length   var_int
+   *    [ ?] addr          uchar[]
+   *    [ 2] port          uint16_t, network byte order
+   */
+  for (; count > 0; count--)
+  {
+    proto_tree *subtree;
+    guint32     start = offset;
+    guint64     services;
+    guint8      network;
+    guint64     addr_length;
+    guint16     port;
+
+    ti = proto_tree_add_item(tree, hf_msg_addrv2_item, tvb, offset, -1, ENC_NA);
+    subtree = proto_item_add_subtree(ti, ett_addrv2);
+
+    proto_tree_add_item(subtree, hf_msg_addrv2_timestamp, tvb, offset, 4, ENC_TIME_TIMESPEC|ENC_LITTLE_ENDIAN);
+    offset += 4;
+
+    get_varint(tvb, offset, &length, &services);
+    proto_tree_add_uint64(subtree, hf_msg_addrv2_services, tvb, offset, length, services);
+    offset += length;
+
+    network = tvb_get_guint8(tvb, offset);
+    proto_tree_add_item(subtree, hf_msg_addrv2_network, tvb, offset, 1, ENC_NA);
+    offset += 1;
+
+    get_varint(tvb, offset, &length, &addr_length);
+    add_varint_item(subtree, tvb, offset, length, addr_length, hf_msg_addrv2_addr_length8, hf_msg_addrv2_addr_length16,
+                    hf_msg_addrv2_addr_length32, hf_msg_addrv2_addr_length64);
+    offset += length;
+
+    /* BIP155 limits addresses to 512 bytes */
+    if (addr_length > 512)
+      THROW(ReportedBoundsError);
+
+    if (network == ADDRV2_NET_IPV4 && addr_length == 4)
+      proto_tree_add_item(subtree, hf_msg_addrv2_address_ipv4, tvb, offset, 4, ENC_BIG_ENDIAN);
+    else if ((network == ADDRV2_NET_IPV6 || network == ADDRV2_NET_CJDNS) && addr_length == 16)
+      proto_tree_add_item(subtree, hf_msg_addrv2_address_ipv6, tvb, offset, 16, ENC_NA);
+    else
+      proto_tree_add_item(subtree, hf_msg_addrv2_address, tvb, offset, (gint)addr_length, ENC_NA);
+    offset += (guint32)addr_length;
+
+    port = tvb_get_ntohs(tvb, offset);
+    proto_tree_add_item(subtree, hf_msg_addrv2_port, tvb, offset, 2, ENC_BIG_ENDIAN);
+    offset += 2;
+
+    proto_item_set_len(ti, offset - start);
+    proto_item_append_text(ti, ", %s", val_to_str_const(network, addrv2_networks, "Unknown network"));
+
+    if (bitcoin_addr_tracking)
+      bitcoin_track_addr(tvb, start, offset - start, pinfo, subtree, network,
+                         tvb_get_ptr(tvb, offset - 2 - (gint)addr_length, (gint)addr_length),
+                         (gsize)addr_length, port, services,
+                         tap_addrs ? &tap_addrs[tap_count++] : NULL);
+  }
+
+  if (tap_addrs)
+    bitcoin_tap_queue_addrs(pinfo, tap_addrs, tap_count);
+}
+
+/**
+ * Height a block commits to in its coinbase (BIP 34), if there is one
+ */
+static guint32
+get_bitcoin_coinbase_height(tvbuff_t *tvb, gint offset)
+{
+  gint    length;
+  guint64 value;
+  guint8  push;
+  guint32 height = 0;
+  gint    i;
+
+  /* block version 2 and up */
+  if (tvb_get_letohl(tvb, 0) < 2)
+    return BITCOIN_HEIGHT_UNKNOWN;
+
+  /* tx version, skipping the segwit marker and flag */
+  offset += 4;
+  if (tvb_bytes_exist(tvb, offset, 2) && tvb_get_guint8(tvb, offset) == 0 && tvb_get_guint8(tvb, offset + 1) == 1)
+    offset += 2;
+
+  /* one input spending the null outpoint */
+  if (!try_get_varint(tvb, offset, &length, &value) || value != 1)
+    return BITCOIN_HEIGHT_UNKNOWN;
+  offset += length + 36;
+
+  if (!try_get_varint(tvb, offset, &length, &value) || value < 2)
+    return BITCOIN_HEIGHT_UNKNOWN;
+  offset += length;
+
+  /* the script starts with a push of the height */
+  if (!tvb_bytes_exist(tvb, offset, 1))
+    return BITCOIN_HEIGHT_UNKNOWN;
+  push = tvb_get_guint8(tvb, offset);
+  if (push < 1 || push > 4 || (guint64)push + 1 > value || !tvb_bytes_exist(tvb, offset + 1, push))
+    return BITCOIN_HEIGHT_UNKNOWN;
+
+  for (i = push; i > 0; i--)
+    height = (height << 8) | tvb_get_guint8(tvb, offset + i);
+
+  return height;
+}
+
+/**
+ * Add what the header chain knows about a block header
+ */
+static void
+dissect_bitcoin_chain_info(tvbuff_t *tvb, gint offset, packet_info *pinfo, proto_tree *tree,
+                           const guint8 *hash)
+{
+  bitcoin_chain_entry_t *entry;
+  bitcoin_chain_entry_t *parent;
+  bitcoin_frame_info_t  *frame_info;
+  proto_item            *ti;
+
+  entry = bitcoin_chain_lookup(pletoh64(hash));
+  if (!entry || !tree)
+    return;
+
+  if (entry->height != BITCOIN_HEIGHT_UNKNOWN)
+  {
+    ti = proto_tree_add_uint(tree, hf_msg_block_height, tvb, offset, 80, entry->height);
+    PROTO_ITEM_SET_GENERATED(ti);
+  }
+
+  parent = bitcoin_chain_lookup(entry->prev);
+  if (parent)
+  {
+    ti = proto_tree_add_uint(tree, hf_msg_block_prev_frame, tvb, offset + 4, 32, parent->frame);
+    PROTO_ITEM_SET_GENERATED(ti);
+
+    /* on an island that doesn't connect to the best chain it's unknown */
+    if (!(entry->flags & BITCOIN_CHAIN_MAIN) && header_chain.tip &&
+        bitcoin_chain_root(entry->fragment) == bitcoin_chain_root(header_chain.entries[header_chain.tip - 1].fragment))
+    {
+      ti = proto_tree_add_boolean(tree, hf_msg_block_stale, tvb, offset, 80, TRUE);
+      PROTO_ITEM_SET_GENERATED(ti);
+      expert_add_info_format(pinfo, ti, PI_SEQUENCE, PI_WARN, "Stale block, not on the best chain");
+    }
+  }
+  else if (entry->height != 0)
+  {
+    ti = proto_tree_add_boolean(tree, hf_msg_block_orphan, tvb, offset + 4, 32, TRUE);
+    PROTO_ITEM_SET_GENERATED(ti);
+  }
+
+  if (entry->flags & BITCOIN_CHAIN_FORK)
+  {
+    ti = proto_tree_add_boolean(tree, hf_msg_block_fork, tvb, offset + 4, 32, TRUE);
+    PROTO_ITEM_SET_GENERATED(ti);
+    expert_add_info_format(pinfo, ti, PI_SEQUENCE, PI_NOTE, "Fork, the previous block already has another child");
+  }
+
+  frame_info = get_bitcoin_frame_info(pinfo, FALSE);
+  if (frame_info && frame_info->reorg_depth > 0 && frame_info->reorg_hash == entry->hash)
+  {
+    ti = proto_tree_add_uint(tree, hf_msg_block_reorg_depth, tvb, offset, 80, frame_info->reorg_depth);
+    PROTO_ITEM_SET_GENERATED(ti);
+    expert_add_info_format(pinfo, ti, PI_SEQUENCE, PI_WARN,
+                           "Reorg, %u block(s) disconnected from the best chain", frame_info->reorg_depth);
+    ti = proto_tree_add_uint(tree, hf_msg_block_reorg_fork_frame, tvb, offset, 80, frame_info->reorg_fork_frame);
+    PROTO_ITEM_SET_GENERATED(ti);
+  }
+}
+
+/**
+ * Resolve a block locator to the first of its hashes on the best chain,
+ * which is where the peer's chain and ours part
+ */
+static void
+dissect_bitcoin_locator(tvbuff_t *tvb, gint offset, guint64 count, proto_tree *tree)
+{
+  bitcoin_chain_entry_t *entry;
+  proto_item            *ti;
+
+  for (; count > 0; count--, offset += 32)
+  {
+    entry = bitcoin_chain_lookup(tvb_get_letoh64(tvb, offset));
+    if (entry && (entry->flags & BITCOIN_CHAIN_MAIN))
+    {
+      ti = add_hash_item(tree, tvb, offset, hf_msg_locator_fork);
+      PROTO_ITEM_SET_GENERATED(ti);
+      if (entry->height != BITCOIN_HEIGHT_UNKNOWN)
+      {
+        ti = proto_tree_add_uint(tree, hf_msg_locator_fork_height, tvb, offset, 32, entry->height);
+        PROTO_ITEM_SET_GENERATED(ti);
+      }
+      ti = proto_tree_add_uint(tree, hf_msg_locator_fork_frame, tvb, offset, 32, entry->frame);
+      PROTO_ITEM_SET_GENERATED(ti);
+      return;
+    }
+  }
+}
+
+/**
+ * Note the first announcement of a block
+ */
+static void
+bitcoin_block_announced(guint64 key, packet_info *pinfo)
+{
+  bitcoin_block_prop_t *prop;
+
+  prop = (bitcoin_block_prop_t *)g_hash_table_lookup(block_prop_table, &key);
+  if (!prop)
+  {
+    prop = g_new0(bitcoin_block_prop_t, 1);
+    prop->hash = key;
+    bitcoin_budget_insert(BITCOIN_STATE_BLOCK_PROP, &prop->hash, prop, pinfo);
+  }
+
+  if (prop->announce_frame == 0)
+  {
+    prop->announce_frame = pinfo->fd->num;
+    prop->announce_time  = pinfo->fd->abs_ts;
+  }
+}
+
+/**
+ * Note the blocks announced by an inv message
+ */
+static void
+bitcoin_inv_blocks_announced(tvbuff_t *tvb, packet_info *pinfo)
+{
+  gint    length;
+  guint64 count;
+  gint    offset;
+
+  if (!try_get_varint(tvb, 0, &length, &count))
+    return;
+
+  for (offset = length; count > 0 && tvb_bytes_exist(tvb, offset, 36); count--, offset += 36)
+  {
+    if (tvb_get_letohl(tvb, offset) == INV_MSG_BLOCK)
+      bitcoin_block_announced(tvb_get_letoh64(tvb, offset + 4), pinfo);
+  }
+}
+
+/**
+ * Note the first receipt of a block in full
+ */
+static bitcoin_block_prop_t *
+bitcoin_block_received(guint64 key, packet_info *pinfo)
+{
+  bitcoin_block_prop_t *prop;
+
+  prop = (bitcoin_block_prop_t *)g_hash_table_lookup(block_prop_table, &key);
+  if (!prop)
+  {
+    prop = g_new0(bitcoin_block_prop_t, 1);
+    prop->hash = key;
+    bitcoin_budget_insert(BITCOIN_STATE_BLOCK_PROP, &prop->hash, prop, pinfo);
+  }
+
+  if (prop->receive_frame == 0)
+  {
+    prop->receive_frame = pinfo->fd->num;
+    prop->receive_time  = pinfo->fd->abs_ts;
+  }
+
+  return prop;
+}
+
+/**
+ * Note a block received in full, add the generated propagation fields and
+ * queue the first receipt from each peer to the tap
+ */
+static void
+dissect_bitcoin_block_prop(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint64 key)
+{
+  bitcoin_block_prop_t *prop;
+  bitcoin_block_peer_t *peer;
+  bitcoin_tap_info_t   *tap_info;
+  proto_item           *ti;
+  nstime_t              delta;
+  guint64               peer_key;
+
+  peer_key = bitcoin_hash64(key, (const guint8 *)pinfo->src.data, pinfo->src.len);
+
+  prop = (bitcoin_block_prop_t *)g_hash_table_lookup(block_prop_table, &key);
+  peer = (bitcoin_block_peer_t *)g_hash_table_lookup(block_peer_table, &peer_key);
+
+  if (!pinfo->fd->flags.visited)
+  {
+    if (!peer)
+    {
+      peer = g_new(bitcoin_block_peer_t, 1);
+      peer->key         = peer_key;
+      peer->first_frame = pinfo->fd->num;
+      bitcoin_budget_insert(BITCOIN_STATE_BLOCK_PEER, &peer->key, peer, pinfo);
+
+      prop = bitcoin_block_received(key, pinfo);
+      prop->last_receive_time = pinfo->fd->abs_ts;
+      prop->peers++;
+    }
+  }
+
+  if (!prop || prop->receive_frame == 0 || prop->receive_frame > pinfo->fd->num)
+    return;
+
+  if (have_tap_listener(bitcoin_tap) && peer && peer->first_frame == pinfo->fd->num)
+  {
+    tap_info = ep_new0(bitcoin_tap_info_t);
+    tap_info->type           = BITCOIN_TAP_BLOCK;
+    tap_info->first_receipt  = prop->receive_frame == pinfo->fd->num;
+    tap_info->announce_delay = -1;
+
+    nstime_delta(&delta, &pinfo->fd->abs_ts, &prop->receive_time);
+    tap_info->first_delay = nstime_to_msec(&delta);
+    if (prop->announce_frame != 0 && prop->announce_frame <= pinfo->fd->num)
+    {
+      nstime_delta(&delta, &pinfo->fd->abs_ts, &prop->announce_time);
+      tap_info->announce_delay = nstime_to_msec(&delta);
+    }
+    tap_queue_packet(bitcoin_tap, pinfo, tap_info);
+  }
+
+  if (!tree)
+    return;
+
+  if (prop->announce_frame != 0 && prop->announce_frame <= pinfo->fd->num)
+  {
+    ti = proto_tree_add_uint(tree, hf_msg_block_prop_announce_frame, tvb, 0, 0, prop->announce_frame);
+    PROTO_ITEM_SET_GENERATED(ti);
+    nstime_delta(&delta, &pinfo->fd->abs_ts, &prop->announce_time);
+    ti = proto_tree_add_time(tree, hf_msg_block_prop_announce_delay, tvb, 0, 0, &delta);
+    PROTO_ITEM_SET_GENERATED(ti);
+  }
+
+  ti = proto_tree_add_uint(tree, hf_msg_block_prop_first_frame, tvb, 0, 0, prop->receive_frame);
+  PROTO_ITEM_SET_GENERATED(ti);
+  nstime_delta(&delta, &pinfo->fd->abs_ts, &prop->receive_time);
+  ti = proto_tree_add_time(tree, hf_msg_block_prop_first_delay, tvb, 0, 0, &delta);
+  PROTO_ITEM_SET_GENERATED(ti);
+
+  ti = proto_tree_add_uint(tree, hf_msg_block_prop_peers, tvb, 0, 0, prop->peers);
+  PROTO_ITEM_SET_GENERATED(ti);
+  nstime_delta(&delta, &prop->last_receive_time, &prop->receive_time);
+  ti = proto_tree_add_time(tree, hf_msg_block_prop_spread, tvb, 0, 0, &delta);
+  PROTO_ITEM_SET_GENERATED(ti);
+}
+
+static guint64
+bitcoin_frame_key(guint32 frame, guint64 hash)
+{
+  return bitcoin_hash64(bitcoin_hash64(BITCOIN_HASH64_INIT, (const guint8 *)&frame, sizeof(frame)),
+                        (const guint8 *)&hash, sizeof(hash));
+}
+
+static guint64
+bitcoin_pending_key(bitcoin_conv_info_t *conv_info, guint direction, guint64 hash)
+{
+  guint64 key;
+
+  key = bitcoin_hash64(BITCOIN_HASH64_INIT, (const guint8 *)&conv_info, sizeof(conv_info));
+  key = bitcoin_hash64(key, (const guint8 *)&direction, sizeof(direction));
+  return bitcoin_hash64(key, (const guint8 *)&hash, sizeof(hash));
+}
+
+/**
+ * Remember the in-flight count of the requesting side for the frame
+ */
+static void
+bitcoin_getdata_set_inflight(packet_info *pinfo, guint32 inflight)
+{
+  bitcoin_frame_info_t *frame_info;
+
+  frame_info = get_bitcoin_frame_info(pinfo, TRUE);
+  frame_info->have_inflight = TRUE;
+  frame_info->inflight      = inflight;
+}
+
+/**
+ * Note an inventory request; an item already in flight isn't requested twice
+ */
+static void
+bitcoin_getdata_request(bitcoin_conv_info_t *conv_info, guint direction, guint64 hash, packet_info *pinfo)
+{
+  bitcoin_getdata_req_t *req;
+  guint64                pending_key = bitcoin_pending_key(conv_info, direction, hash);
+
+  if (g_hash_table_lookup(getdata_pending_table, &pending_key))
+    return;
+
+  req = g_new0(bitcoin_getdata_req_t, 1);
+  req->key         = bitcoin_frame_key(pinfo->fd->num, hash);
+  req->pending_key = pending_key;
+  req->frame       = pinfo->fd->num;
+  req->time        = pinfo->fd->abs_ts;
+  req->conv_info   = conv_info;
+  req->direction   = direction;
+  bitcoin_budget_insert(BITCOIN_STATE_GETDATA, &req->key, req, pinfo);
+  g_hash_table_insert(getdata_pending_table, &req->pending_key, req);
+
+  bitcoin_getdata_set_inflight(pinfo, ++conv_info->inflight[direction]);
+}
+
+/**
+ * Add the generated fields of an inventory request
+ */
+static void
+dissect_bitcoin_getdata_request(tvbuff_t *tvb, gint offset, packet_info *pinfo, proto_tree *tree)
+{
+  bitcoin_getdata_req_t *req;
+  proto_item            *ti;
+  nstime_t               delta;
+  guint64                key = bitcoin_frame_key(pinfo->fd->num, tvb_get_letoh64(tvb, offset));
+
+  req = (bitcoin_getdata_req_t *)g_hash_table_lookup(getdata_req_table, &key);
+  if (!req)
+    return;
+
+  if (req->answer_frame == 0)
+  {
+    nstime_delta(&delta, &getdata_last_time, &req->time);
+    ti = proto_tree_add_boolean(tree, hf_msg_getdata_unanswered, tvb, offset, 32, TRUE);
+    PROTO_ITEM_SET_GENERATED(ti);
+    if (nstime_to_msec(&delta) > bitcoin_getdata_timeout)
+      expert_add_info_format(pinfo, ti, PI_SEQUENCE, PI_WARN,
+                             "Request stalled, not answered within %u ms", bitcoin_getdata_timeout);
+    return;
+  }
+
+  ti = proto_tree_add_uint(tree, hf_msg_getdata_answer_frame, tvb, offset, 32, req->answer_frame);
+  PROTO_ITEM_SET_GENERATED(ti);
+  nstime_delta(&delta, &req->answer_time, &req->time);
+  ti = proto_tree_add_time(tree, hf_msg_getdata_response_time, tvb, offset, 32, &delta);
+  PROTO_ITEM_SET_GENERATED(ti);
+  if (nstime_to_msec(&delta) > bitcoin_getdata_timeout)
+    expert_add_info_format(pinfo, ti, PI_SEQUENCE, PI_WARN,
+                           "Request stalled, answered after more than %u ms", bitcoin_getdata_timeout);
+  if (req->notfound)
+  {
+    ti = proto_tree_add_boolean(tree, hf_msg_getdata_notfound, tvb, offset, 32, TRUE);
+    PROTO_ITEM_SET_GENERATED(ti);
+  }
+}
+
+/**
+ * Match a tx, block, cmpctblock or notfound item against the requests of
+ * the other side and add the generated fields
+ */
+static void
+dissect_bitcoin_getdata_answer(tvbuff_t *tvb, gint offset, gint length, packet_info *pinfo,
+                               proto_tree *tree, guint64 hash, gboolean notfound)
+{
+  bitcoin_getdata_req_t *req;
+  proto_item            *ti;
+  nstime_t               delta;
+  guint64                key = bitcoin_frame_key(pinfo->fd->num, hash);
+
+  if (!pinfo->fd->flags.visited)
+  {
+    bitcoin_conv_info_t *conv_info = get_bitcoin_conv_info(pinfo);
+    guint                direction = 1 - get_bitcoin_direction(conv_info, pinfo);
+    guint64              pending_key = bitcoin_pending_key(conv_info, direction, hash);
+
+    req = (bitcoin_getdata_req_t *)g_hash_table_lookup(getdata_pending_table, &pending_key);
+    if (req)
+    {
+      g_hash_table_remove(getdata_pending_table, &pending_key);
+      req->answer_frame = pinfo->fd->num;
+      req->answer_time  = pinfo->fd->abs_ts;
+      req->answer_key   = key;
+      req->notfound     = notfound;
+      g_hash_table_insert(getdata_answer_table, &req->answer_key, req);
+
+      bitcoin_getdata_set_inflight(pinfo, --conv_info->inflight[direction]);
+    }
+  }
+
+  req = (bitcoin_getdata_req_t *)g_hash_table_lookup(getdata_answer_table, &key);
+  if (!req || !tree)
+    return;
+
+  ti = proto_tree_add_uint(tree, hf_msg_getdata_request_frame, tvb, offset, length, req->frame);
+  PROTO_ITEM_SET_GENERATED(ti);
+  nstime_delta(&delta, &req->answer_time, &req->time);
+  ti = proto_tree_add_time(tree, hf_msg_getdata_response_time, tvb, offset, length, &delta);
+  PROTO_ITEM_SET_GENERATED(ti);
+  if (nstime_to_msec(&delta) > bitcoin_getdata_timeout)
+    expert_add_info_format(pinfo, ti, PI_SEQUENCE, PI_WARN,
+                           "Request stalled, answered after more than %u ms", bitcoin_getdata_timeout);
+}
+
+/**
+ * Add the in-flight count of the requesting side after the frame
+ */
+static void
+dissect_bitcoin_getdata_inflight(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
+{
+  bitcoin_frame_info_t *frame_info;
+  proto_item           *ti;
+
+  frame_info = get_bitcoin_frame_info(pinfo, FALSE);
+  if (!frame_info || !frame_info->have_inflight)
+    return;
+
+  ti = proto_tree_add_uint(tree, hf_msg_getdata_inflight, tvb, 0, 0, frame_info->inflight);
+  PROTO_ITEM_SET_GENERATED(ti);
+}
+
+/**
+ * Whether a side had negotiated a feature by the frame being dissected
+ */
+static gboolean
+bitcoin_feature_active(bitcoin_conv_info_t *conv_info, guint direction, guint feature, packet_info *pinfo)
+{
+  guint32 frame = conv_info->feature_frame[direction][feature];
+  guint   i;
+
+  if (feature == BITCOIN_FEATURE_SENDCMPCT_HB)
+  {
+    /* on after an odd number of transitions */
+    for (i = 0; i < conv_info->hb_toggle_count[direction] &&
+                conv_info->hb_toggles[direction][i] <= pinfo->fd->num; i++)
+      ;
+    return (i & 1) != 0;
+  }
+
+  return frame != 0 && frame <= pinfo->fd->num;
+}
+
+/**
+ * Note a side turning high-bandwidth compact block mode on or off
+ */
+static void
+bitcoin_sendcmpct_announce(bitcoin_conv_info_t *conv_info, guint direction, gboolean announce,
+                           packet_info *pinfo)
+{
+  guint    count = conv_info->hb_toggle_count[direction];
+  guint32 *toggles;
+
+  /* already in that mode */
+  if (((count & 1) != 0) == announce)
+    return;
+
+  if (count == conv_info->hb_toggle_size[direction])
+  {
+    conv_info->hb_toggle_size[direction] = MAX(4, count * 2);
+    toggles = (guint32 *)se_alloc(conv_info->hb_toggle_size[direction] * sizeof(guint32));
+    if (count > 0)
+      memcpy(toggles, conv_info->hb_toggles[direction], count * sizeof(guint32));
+    conv_info->hb_toggles[direction] = toggles;
+  }
+
+  conv_info->hb_toggles[direction][count] = pinfo->fd->num;
+  conv_info->hb_toggle_count[direction]   = count + 1;
+}
+
+/**
+ * List the features a side had negotiated by the frame being dissected
+ */
+static const gchar *
+bitcoin_feature_list(bitcoin_conv_info_t *conv_info, guint direction, packet_info *pinfo)
+{
+  emem_strbuf_t *strbuf;
+  guint          i;
+
+  strbuf = ep_strbuf_new(NULL);
+  for (i = 0; i < BITCOIN_FEATURE_COUNT; i++)
+  {
+    if (bitcoin_feature_active(conv_info, direction, i, pinfo))
+      ep_strbuf_append_printf(strbuf, "%s%s", strbuf->len ? ", " : "",
+                              val_to_str_const(i, bitcoin_features, "?"));
+  }
+
+  return strbuf->len ? strbuf->str : "none";
+}
+
+/**
+ * Fold a negotiation message into the state of its conversation and add
+ * where it stands in the handshake
+ */
+static void
+dissect_bitcoin_negotiation(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, guint feature)
+{
+  bitcoin_conv_info_t *conv_info;
+  proto_item          *ti;
+  guint                direction;
+  gboolean             late;
+
+  conv_info = get_bitcoin_conv_info(pinfo);
+  direction = get_bitcoin_direction(conv_info, pinfo);
+
+  if (!pinfo->fd->flags.visited && conv_info->feature_frame[direction][feature] == 0)
+  {
+    if (conv_info->feature_frame[direction][BITCOIN_FEATURE_VERACK] != 0)
+      conv_info->late_features[direction] |= 1 << feature;
+    conv_info->feature_frame[direction][feature] = pinfo->fd->num;
+    conv_info->feature_order[direction][feature] = ++conv_info->feature_count[direction];
+  }
+
+  if (!tree)
+    return;
+
+  if (feature != BITCOIN_FEATURE_VERACK)
+  {
+    ti = proto_tree_add_uint(tree, hf_bitcoin_negotiation_order, tvb, 0, 0,
+                             conv_info->feature_order[direction][feature]);
+    PROTO_ITEM_SET_GENERATED(ti);
+
+    late = (conv_info->late_features[direction] & (1 << feature)) != 0;
+    ti = proto_tree_add_boolean(tree, hf_bitcoin_negotiation_after_verack, tvb, 0, 0, late);
+    PROTO_ITEM_SET_GENERATED(ti);
+
+    /* BIP 339 and BIP 155 */
+    if (late && (feature == BITCOIN_FEATURE_WTXIDRELAY || feature == BITCOIN_FEATURE_SENDADDRV2))
+      expert_add_info_format(pinfo, ti, PI_PROTOCOL, PI_WARN, "%s must be sent before verack",
+                             val_to_str_const(feature, bitcoin_features, "?"));
+  }
+
+  ti = proto_tree_add_string(tree, hf_bitcoin_negotiation_sender, tvb, 0, 0,
+                             bitcoin_feature_list(conv_info, direction, pinfo));
+  PROTO_ITEM_SET_GENERATED(ti);
+  ti = proto_tree_add_string(tree, hf_bitcoin_negotiation_peer, tvb, 0, 0,
+                             bitcoin_feature_list(conv_info, 1 - direction, pinfo));
+  PROTO_ITEM_SET_GENERATED(ti);
+}
+
+/**
+ * Link an inventory hash to the frame carrying the object, the first relay
+ * of a tx or the first receipt of a block in full
+ */
+static void
+dissect_bitcoin_object_frame(tvbuff_t *tvb, gint offset, proto_tree *tree, const guint8 *hash)
+{
+  bitcoin_tx_seen_t    *seen;
+  bitcoin_block_prop_t *prop;
+  proto_item           *ti;
+  guint32               frame;
+  guint64               key = pletoh64(hash);
+
+  seen = (bitcoin_tx_seen_t *)g_hash_table_lookup(tx_seen_table, &key);
+  if (seen)
+    frame = seen->first_frame;
+  else
+  {
+    prop = (bitcoin_block_prop_t *)g_hash_table_lookup(block_prop_table, &key);
+    if (!prop || prop->receive_frame == 0)
+      return;
+    frame = prop->receive_frame;
+  }
+
+  ti = proto_tree_add_uint(tree, hf_msg_inv_object_frame, tvb, offset, 32, frame);
+  PROTO_ITEM_SET_GENERATED(ti);
+}
+
+/**
+ * Show the hash of single entry inventory messages in the Info column
+ */
+static void
+bitcoin_info_inv_detail(tvbuff_t *tvb)
+{
+  gint    length;
+  guint64 count;
+
+  if (!info_tally)
+    return;
+
+  if (try_get_varint(tvb, 0, &length, &count) && count == 1 && tvb_bytes_exist(tvb, length+4, 32))
+    bitcoin_info_detail(bitcoin_hash_to_str(tvb_get_ptr(tvb, length+4, 32)));
+}
+
+/* Inventory vector messages (inv, getdata, notfound) and block locator
+ * messages (getblocks, getheaders) share their layout and only differ in
+ * their fields and in what is done with each entry, so they are described
+ * by the tables below and dissected by one loop each.
+ */
+typedef void (*inv_entry_func_t)(tvbuff_t *tvb, gint offset, packet_info *pinfo, proto_tree *tree,
+                                 proto_item *type_item, guint32 type, bitcoin_conv_info_t *conv_info);
+
+typedef struct _bitcoin_inv_layout {
+  gint             *hf_msg;
+  gint             *hf_count[4];   /* var_int count, by encoded length */
+  gint             *hf_type;
+  gint             *hf_hash;
+  gint             *ett_list;
+  inv_entry_func_t  entry;         /* per entry extras, or NULL */
+  gboolean          getdata;       /* show the getdata requests in flight */
+} bitcoin_inv_layout_t;
+
+typedef struct _bitcoin_locator_layout {
+  gint *hf_msg;
+  gint *hf_count[4];
+  gint *hf_start;
+  gint *hf_stop;
+} bitcoin_locator_layout_t;
+
+/**
+ * Flag txs announced by the other id than the one negotiated (BIP 339)
+ */
+static void
+bitcoin_inv_entry(tvbuff_t *tvb _U_, gint offset _U_, packet_info *pinfo, proto_tree *tree _U_,
+                  proto_item *type_item, guint32 type, bitcoin_conv_info_t *conv_info)
+{
+  gboolean wtxid;
+
+  if (type != INV_MSG_TX && type != INV_MSG_WTX)
+    return;
+
+  wtxid = bitcoin_feature_active(conv_info, 0, BITCOIN_FEATURE_WTXIDRELAY, pinfo) &&
+          bitcoin_feature_active(conv_info, 1, BITCOIN_FEATURE_WTXIDRELAY, pinfo);
+
+  if (type == INV_MSG_TX && wtxid)
+    expert_add_info_format(pinfo, type_item, PI_PROTOCOL, PI_NOTE, "Tx announced by txid although wtxidrelay was negotiated");
+  else if (type == INV_MSG_WTX && !wtxid)
+    expert_add_info_format(pinfo, type_item, PI_PROTOCOL, PI_WARN, "Tx announced by wtxid without wtxidrelay negotiated");
+}
+
+static void
+bitcoin_getdata_entry(tvbuff_t *tvb, gint offset, packet_info *pinfo, proto_tree *tree,
+                      proto_item *type_item _U_, guint32 type _U_, bitcoin_conv_info_t *conv_info _U_)
+{
+  if (bitcoin_track_getdata)
+    dissect_bitcoin_getdata_request(tvb, offset, pinfo, tree);
+}
+
+static void
+bitcoin_notfound_entry(tvbuff_t *tvb, gint offset, packet_info *pinfo, proto_tree *tree,
+                       proto_item *type_item _U_, guint32 type _U_, bitcoin_conv_info_t *conv_info _U_)
+{
+  if (bitcoin_track_getdata)
+    dissect_bitcoin_getdata_answer(tvb, offset, 32, pinfo, tree, tvb_get_letoh64(tvb, offset), TRUE);
+}
+
+static const bitcoin_inv_layout_t inv_layout = {
+  &hf_bitcoin_msg_inv,
+  { &hf_msg_inv_count8, &hf_msg_inv_count16, &hf_msg_inv_count32, &hf_msg_inv_count64 },
+  &hf_msg_inv_type, &hf_msg_inv_hash, &ett_inv_list,
+  bitcoin_inv_entry, FALSE
+};
+
+static const bitcoin_inv_layout_t getdata_layout = {
+  &hf_bitcoin_msg_getdata,
+  { &hf_msg_getdata_count8, &hf_msg_getdata_count16, &hf_msg_getdata_count32, &hf_msg_getdata_count64 },
+  &hf_msg_getdata_type, &hf_msg_getdata_hash, &ett_getdata_list,
+  bitcoin_getdata_entry, TRUE
+};
+
+static const bitcoin_inv_layout_t notfound_layout = {
+  &hf_bitcoin_msg_notfound,
+  { &hf_msg_notfound_count8, &hf_msg_notfound_count16, &hf_msg_notfound_count32, &hf_msg_notfound_count64 },
+  &hf_msg_notfound_type, &hf_msg_notfound_hash, &ett_notfound_list,
+  bitcoin_notfound_entry, TRUE
+};
+
+static const bitcoin_locator_layout_t getblocks_layout = {
+  &hf_bitcoin_msg_getblocks,
+  { &hf_msg_getblocks_count8, &hf_msg_getblocks_count16, &hf_msg_getblocks_count32, &hf_msg_getblocks_count64 },
+  &hf_msg_getblocks_start, &hf_msg_getblocks_stop
+};
+
+static const bitcoin_locator_layout_t getheaders_layout = {
+  &hf_bitcoin_msg_getheaders,
+  { &hf_msg_getheaders_count8, &hf_msg_getheaders_count16, &hf_msg_getheaders_count32, &hf_msg_getheaders_count64 },
+  &hf_msg_getheaders_start, &hf_msg_getheaders_stop
+};
+
+/**
+ * Dissect a message made of inventory vectors
+ */
+static void
+dissect_bitcoin_inv_vector(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, const bitcoin_inv_layout_t *layout)
+{
+  proto_item          *ti;
+  gint                 length;
+  guint64              count;
+  guint32              offset = 0;
+  bitcoin_conv_info_t *conv_info;
+
+  conv_info = get_bitcoin_conv_info(pinfo);
+
+  ti   = proto_tree_add_item(tree, *layout->hf_msg, tvb, offset, -1, ENC_NA);
+  tree = proto_item_add_subtree(ti, ett_bitcoin_msg);
+
+  get_varint(tvb, offset, &length, &count);
+  add_varint_item(tree, tvb, offset, length, count, *layout->hf_count[0], *layout->hf_count[1],
+                  *layout->hf_count[2], *layout->hf_count[3]);
+
+  offset += length;
+
+  for (; count > 0; count--)
+  {
+    proto_tree   *subtree;
+    const guint8 *entry = tvb_get_ptr(tvb, offset, 36);
+    guint32       type  = pletohl(entry);
+
+    ti = proto_tree_add_text(tree, tvb, offset, 36, "Inventory vector");
+    subtree = proto_item_add_subtree(ti, *layout->ett_list);
+
+    ti = proto_tree_add_uint(subtree, *layout->hf_type, tvb, offset, 4, type);
+    offset += 4;
+
+    add_hash_item_ptr(subtree, tvb, offset, *layout->hf_hash, entry + 4);
+    if (bitcoin_object_index)
+      dissect_bitcoin_object_frame(tvb, offset, subtree, entry + 4);
+    if (layout->entry)
+      layout->entry(tvb, offset, pinfo, subtree, ti, type, conv_info);
+    offset += 32;
+  }
+
+  if (layout->getdata && bitcoin_track_getdata)
+    dissect_bitcoin_getdata_inflight(tvb, pinfo, tree);
+}
+
+/**
+ * Dissect a message carrying a block locator
+ */
+static void
+dissect_bitcoin_locator_msg(tvbuff_t *tvb, proto_tree *tree, const bitcoin_locator_layout_t *layout)
+{
+  proto_item *ti;
+  gint        length;
+  guint64     count;
+  guint32     offset = 0;
+
+  ti   = proto_tree_add_item(tree, *layout->hf_msg, tvb, offset, -1, ENC_NA);
+  tree = proto_item_add_subtree(ti, ett_bitcoin_msg);
+
+  /* why the protcol version is sent here nobody knows */
+  proto_tree_add_item(tree, hf_msg_version_version, tvb, offset, 4, ENC_LITTLE_ENDIAN);
+  offset += 4;
+
+  get_varint(tvb, offset, &length, &count);
+  add_varint_item(tree, tvb, offset, length, count, *layout->hf_count[0], *layout->hf_count[1],
+                  *layout->hf_count[2], *layout->hf_count[3]);
+
+  offset += length;
+
+  if (bitcoin_header_chain)
+    dissect_bitcoin_locator(tvb, offset, count, tree);
+
+  for (; count > 0; count--)
+  {
+    add_hash_item(tree, tvb, offset, *layout->hf_start);
+    offset += 32;
+  }
+
+  add_hash_item(tree, tvb, offset, *layout->hf_stop);
+}
+
+/**
+ * Handler for inventory messages
+ */
+static void
+dissect_bitcoin_msg_inv(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
+{
+  bitcoin_info_inv_detail(tvb);
+
+  if (bitcoin_block_propagation && !pinfo->fd->flags.visited)
+    bitcoin_inv_blocks_announced(tvb, pinfo);
+
+  if (!tree)
+    return;
+
+  dissect_bitcoin_inv_vector(tvb, pinfo, tree, &inv_layout);
+}
+
+/**
+ * Handler for getdata messages
+ */
+static void
+dissect_bitcoin_msg_getdata(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
+{
+  gint    length;
+  guint64 count;
+  guint32 offset;
+
+  bitcoin_info_inv_detail(tvb);
+
+  if (bitcoin_track_getdata && !pinfo->fd->flags.visited &&
+      try_get_varint(tvb, 0, &length, &count))
+  {
+    bitcoin_conv_info_t *conv_info = get_bitcoin_conv_info(pinfo);
+    guint                direction = get_bitcoin_direction(conv_info, pinfo);
+
+    for (offset = length; count > 0 && tvb_bytes_exist(tvb, offset, 36); count--, offset += 36)
+    {
+      guint32 type = tvb_get_letohl(tvb, offset) & ~INV_MSG_WITNESS_FLAG;
+
+      /* only requests answered by a message keyed by the same hash can be
+       * matched: witness txs by their txid, MSG_WTX by the wtxid of the tx
+       * answering it; filtered blocks are answered by merkleblock, which
+       * isn't tracked
+       */
+      if (type == INV_MSG_TX || type == INV_MSG_WTX || type == INV_MSG_BLOCK || type == INV_MSG_CMPCT_BLOCK)
+        bitcoin_getdata_request(conv_info, direction, tvb_get_letoh64(tvb, offset + 4), pinfo);
+    }
+  }
+
+  if (!tree)
+    return;
+
+  dissect_bitcoin_inv_vector(tvb, pinfo, tree, &getdata_layout);
+}
+
+/**
+ * Handler for notfound messages
+ */
+static void
+dissect_bitcoin_msg_notfound(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
+{
+  gint    length;
+  guint64 count;
+  guint32 offset;
+
+  bitcoin_info_inv_detail(tvb);
+
+  if (bitcoin_track_getdata && !tree && !pinfo->fd->flags.visited &&
+      try_get_varint(tvb, 0, &length, &count))
+  {
+    for (offset = length; count > 0 && tvb_bytes_exist(tvb, offset, 36); count--, offset += 36)
+      dissect_bitcoin_getdata_answer(tvb, offset + 4, 32, pinfo, NULL, tvb_get_letoh64(tvb, offset + 4), TRUE);
+  }
+
+  if (!tree)
+    return;
+
+  dissect_bitcoin_inv_vector(tvb, pinfo, tree, &notfound_layout);
+}
+
+/**
+ * Handler for getblocks messages
+ */
+static void
+dissect_bitcoin_msg_getblocks(tvbuff_t *tvb, packet_info *pinfo _U_, proto_tree *tree)
+{
+  if (!tree)
+    return;
+
+  dissect_bitcoin_locator_msg(tvb, tree, &getblocks_layout);
+}
+
+/**
+ * Handler for getheaders messages
+ */
+static void
+dissect_bitcoin_msg_getheaders(tvbuff_t *tvb, packet_info *pinfo _U_, proto_tree *tree)
+{
+  if (!tree)
+    return;
+
+  dissect_bitcoin_locator_msg(tvb, tree, &getheaders_layout);
+}
+
+/**
+ * Add an ancestor to the set of a tx unless it is already in it
+ */
+static void
+bitcoin_tx_ancestor_add(bitcoin_tx_info_t *tx_info, guint64 ancestor)
+{
+  guint i;
+
+  for (i = 0; i < tx_info->ancestor_count && tx_info->ancestors[i] != ancestor; i++)
+    ;
+  if (i == tx_info->ancestor_count && i < BITCOIN_MAX_ANCESTORS)
+    tx_info->ancestors[tx_info->ancestor_count++] = ancestor;
+}
+
+/**
+ * Add the generated fee and feerate fields of a tx of size bytes; feerates
+ * are per virtual byte, a quarter of the weight (BIP 141) rounded up
+ */
+static void
+dissect_bitcoin_tx_fee(tvbuff_t *tvb, guint32 offset, guint32 size, guint32 vsize, packet_info *pinfo,
+                       proto_tree *tree, const guint8 *txid, guint64 fee, const guint64 *parents,
+                       guint parent_count, guint msgnum)
+{
+  proto_item        *ti;
+  bitcoin_tx_info_t *tx_info;
+  guint64            key = pletoh64(txid);
+
+  tx_info = (bitcoin_tx_info_t *)g_hash_table_lookup(tx_info_table, &key);
+  if (!tx_info && !pinfo->fd->flags.visited)
+  {
+    bitcoin_tx_info_t *ancestor;
+    guint              i;
+    guint              j;
+
+    tx_info = g_new(bitcoin_tx_info_t, 1);
+    tx_info->txid           = key;
+    tx_info->frame          = pinfo->fd->num;
+    tx_info->fee            = fee;
+    tx_info->size           = vsize;
+    tx_info->ancestor_fee   = fee;
+    tx_info->ancestor_size  = vsize;
+    tx_info->ancestor_count = 0;
+
+    /* the union of the parents and their ancestors, so an ancestor shared
+     * by several parents counts once
+     */
+    for (i = 0; i < parent_count; i++)
+    {
+      ancestor = (bitcoin_tx_info_t *)g_hash_table_lookup(tx_info_table, &parents[i]);
+      if (!ancestor)
+        continue;
+      bitcoin_tx_ancestor_add(tx_info, ancestor->txid);
+      for (j = 0; j < ancestor->ancestor_count; j++)
+        bitcoin_tx_ancestor_add(tx_info, ancestor->ancestors[j]);
+    }
+
+    for (i = 0; i < tx_info->ancestor_count; i++)
+    {
+      ancestor = (bitcoin_tx_info_t *)g_hash_table_lookup(tx_info_table, &tx_info->ancestors[i]);
+      if (ancestor)
+      {
+        tx_info->ancestor_fee  += ancestor->fee;
+        tx_info->ancestor_size += ancestor->size;
+      }
+    }
+
+    bitcoin_budget_insert(BITCOIN_STATE_TX_INFO, &tx_info->txid, tx_info, pinfo);
+  }
+
+  ti = proto_tree_add_uint(tree, hf_msg_tx_size, tvb, offset, size, size);
+  PROTO_ITEM_SET_GENERATED(ti);
+  ti = proto_tree_add_uint(tree, hf_msg_tx_vsize, tvb, offset, size, vsize);
+  PROTO_ITEM_SET_GENERATED(ti);
+  ti = proto_tree_add_uint64(tree, hf_msg_tx_fee, tvb, offset, size, fee);
+  PROTO_ITEM_SET_GENERATED(ti);
+  ti = proto_tree_add_double(tree, hf_msg_tx_feerate, tvb, offset, size, (gdouble)fee / vsize);
+  PROTO_ITEM_SET_GENERATED(ti);
+
+  if (tx_info && tx_info->ancestor_size > vsize)
+  {
+    ti = proto_tree_add_double(tree, hf_msg_tx_package_feerate, tvb, offset, size,
+                               (gdouble)tx_info->ancestor_fee / tx_info->ancestor_size);
+    PROTO_ITEM_SET_GENERATED(ti);
+  }
+
+  /* only relayed txs count for the feerate statistics, each once where it
+   * was first seen
+   */
+  if (msgnum == 0 && tx_info && tx_info->frame == pinfo->fd->num && have_tap_listener(bitcoin_tap))
+  {
+    bitcoin_tap_info_t *tap_info;
+
+    tap_info = ep_new(bitcoin_tap_info_t);
+    tap_info->type    = BITCOIN_TAP_TX;
+    tap_info->size    = vsize;
+    tap_info->fee     = fee;
+    tap_info->feerate = (gdouble)fee / vsize;
+    tap_queue_packet(bitcoin_tap, pinfo, tap_info);
+  }
+}
+
+/**
+ * Read a variable length integer of a tx being dissected; the tx was
+ * walked already, so running past its end means a corrupt buffer
+ */
+static void
+bitcoin_tx_varint(const guint8 *data, guint32 length, guint32 *pos, guint64 *ret)
+{
+  if (!bitcoin_ptr_varint(data, length, pos, ret))
+    THROW(ReportedBoundsError);
+}
+
+/**
+ * Check that count more bytes of a tx being dissected are there
+ */
+static void
+bitcoin_tx_need(guint32 length, guint32 pos, guint64 count)
+{
+  if (pos > length || count > length - pos)
+    THROW(ReportedBoundsError);
+}
+
+/**
+ * Handler for tx message body
+ */
+static guint32
+dissect_bitcoin_msg_tx_common(tvbuff_t *tvb, guint32 offset, packet_info *pinfo, proto_tree *tree, guint msgnum,
+                              const guint8 *known_txid)
+{
+  proto_item   *rti;
+  guint64       in_count;
+  guint64       out_count;
+  guint8        txid[32];
+  gboolean      have_txid = FALSE;
+  guint32       vout;
+  guint32       start = offset;
+  guint32       tx_length;
+  bitcoin_tx_layout_t layout;
+  guint64       inputs;
+  const guint8 *data;
+  guint32       pos = 0;
+  guint32       field;
+  guint64       in_value = 0;
+  guint64       out_value = 0;
+  gboolean      have_in_value = TRUE;
+  guint64       parents[BITCOIN_MAX_PARENTS];
+  guint         parent_count = 0;
+
+  if (msgnum == 0) {
+    rti  = proto_tree_add_item(tree, hf_bitcoin_msg_tx, tvb, offset, -1, ENC_NA);
+  } else {
+    rti  = proto_tree_add_none_format(tree, hf_bitcoin_msg_tx, tvb, offset, -1, "Tx message [ %4d ]", msgnum);
+  }
+  tree = proto_item_add_subtree(rti, ett_bitcoin_msg);
+
+  /* Validate the whole tx once and decode it from a single contiguous
+   * buffer through bounded reads; the tree items below are added from the
+   * decoded values, so no byte is fetched from the (possibly composite)
+   * tvbuff twice.
+   */
+  tx_length = get_bitcoin_tx_layout(tvb, offset, &layout);
+  if (tx_length == 0)
+    THROW(tvb_length(tvb) < tvb_reported_length(tvb) ? BoundsError : ReportedBoundsError);
+  data = tvb_get_ptr(tvb, start, tx_length);
+
+  /* with the outpoint index on this also runs without a tree on the first pass */
+  if (known_txid)
+  {
+    memcpy(txid, known_txid, sizeof(txid));
+    have_txid = TRUE;
+  }
+  else if (tree || bitcoin_outpoint_index)
+  {
+    get_bitcoin_txid(tvb, start, &layout, txid);
+    have_txid = TRUE;
+  }
+
+  if (tree && have_txid)
+  {
+    proto_item *ti;
+    guint8      reversed[32];
+
+    bitcoin_hash_reverse(txid, reversed);
+    ti = proto_tree_add_bytes(tree, hf_msg_tx_txid, tvb, start, tx_length, reversed);
+    PROTO_ITEM_SET_GENERATED(ti);
+  }
+
+  if (tree && layout.witness)
+  {
+    proto_item *ti;
+    guint8      wtxid[32];
+    guint8      reversed[32];
+
+    get_bitcoin_wtxid(tvb, start, &layout, wtxid);
+    bitcoin_hash_reverse(wtxid, reversed);
+    ti = proto_tree_add_bytes(tree, hf_msg_tx_wtxid, tvb, start, tx_length, reversed);
+    PROTO_ITEM_SET_GENERATED(ti);
+  }
+
+  bitcoin_tx_need(tx_length, pos, 4);
+  proto_tree_add_uint(tree, hf_msg_tx_version, tvb, start + pos, 4, pletohl(data + pos));
+  pos += 4;
+
+  /* marker and flag (BIP 144) */
+  if (layout.witness)
+  {
+    bitcoin_tx_need(tx_length, pos, 2);
+    proto_tree_add_uint(tree, hf_msg_tx_flag, tvb, start + pos, 2, pntohs(data + pos));
+    pos += 2;
+  }
+
+  /* TxIn[] */
+  field = pos;
+  bitcoin_tx_varint(data, tx_length, &pos, &in_count);
+  inputs = in_count;
+  add_varint_item(tree, tvb, start + field, pos - field, in_count, hf_msg_tx_in_count8, hf_msg_tx_in_count16,
+                  hf_msg_tx_in_count32, hf_msg_tx_in_count64);
+
+  /* TxIn
+   *   [36]  previous_output    outpoint
+   *   [1+]  script length      var_int
+   *   [ ?]  signature script   uchar[]
+   *   [ 4]  sequence           uint32_t
+   *
+   * outpoint (aka previous output)
+   *   [32]  hash               char[32
+   *   [ 4]  index              uint32_t
+   *
+   */
+  for (; in_count > 0; in_count--)
+  {
+    proto_tree   *subtree;
+    proto_tree   *prevtree;
+    proto_item   *ti;
+    proto_item   *pti;
+    guint64       script_length;
+    const guint8 *in;
+    guint32       in_pos = pos;
+    guint32       index;
+
+    bitcoin_tx_need(tx_length, pos, 36);
+    in    = data + pos;
+    index = pletohl(in + 32);
+    pos  += 36;
+
+    field = pos;
+    bitcoin_tx_varint(data, tx_length, &pos, &script_length);
+    bitcoin_tx_need(tx_length, pos, script_length + 4);
+
+    ti = proto_tree_add_item(tree, hf_msg_tx_in, tvb, start + in_pos,
+        (pos - in_pos) + (guint)script_length + 4, ENC_NA);
+    subtree = proto_item_add_subtree(ti, ett_tx_in_list);
+
+    /* previous output */
+    pti = proto_tree_add_item(subtree, hf_msg_tx_in_prev_output, tvb, start + in_pos, 36, ENC_NA);
+    prevtree = proto_item_add_subtree(pti, ett_tx_in_outp);
+
+    add_hash_item_ptr(prevtree, tvb, start + in_pos, hf_msg_tx_in_prev_outp_hash, in);
+    proto_tree_add_uint(prevtree, hf_msg_tx_in_prev_outp_index, tvb, start + in_pos + 32, 4, index);
+
+    if (bitcoin_outpoint_index)
+    {
+      const bitcoin_outpoint_t *outpoint;
+
+      outpoint = outpoint_table_lookup(in, index);
+      if (!outpoint)
+        have_in_value = FALSE;
+      else
+      {
+        proto_item *gti;
+        guint64     parent = outpoint->txid;
+        guint       i;
+
+        in_value += outpoint->value;
+
+        for (i = 0; i < parent_count && parents[i] != parent; i++)
+          ;
+        if (i == parent_count && parent_count < BITCOIN_MAX_PARENTS)
+          parents[parent_count++] = parent;
+
+        gti = proto_tree_add_uint(prevtree, hf_msg_tx_in_prev_frame, tvb, start + in_pos, 36, outpoint->frame);
+        PROTO_ITEM_SET_GENERATED(gti);
+        gti = proto_tree_add_uint64(prevtree, hf_msg_tx_in_prev_value, tvb, start + in_pos, 36, outpoint->value);
+        PROTO_ITEM_SET_GENERATED(gti);
+        gti = proto_tree_add_uint(prevtree, hf_msg_tx_in_prev_script_type, tvb, start + in_pos, 36, outpoint->script_type);
+        PROTO_ITEM_SET_GENERATED(gti);
+      }
+    }
+    /* end previous output */
+
+    add_varint_item(subtree, tvb, start + field, pos - field, script_length, hf_msg_tx_in_script8, hf_msg_tx_in_script16,
+                    hf_msg_tx_in_script32, hf_msg_tx_in_script64);
+
+    proto_tree_add_bytes(subtree, hf_msg_tx_in_sig_script, tvb, start + pos, (guint)script_length, data + pos);
+    pos += (guint32)script_length;
+
+    proto_tree_add_uint(subtree, hf_msg_tx_in_seq, tvb, start + pos, 4, pletohl(data + pos));
+    pos += 4;
+  }
+
+  /* TxOut[] */
+  field = pos;
+  bitcoin_tx_varint(data, tx_length, &pos, &out_count);
+  add_varint_item(tree, tvb, start + field, pos - field, out_count, hf_msg_tx_out_count8, hf_msg_tx_out_count16,
+                  hf_msg_tx_out_count32, hf_msg_tx_out_count64);
+
+  /*  TxOut
+   *    [ 8] value
+   *    [1+] script length [var_int]
+   *    [ ?] script
+   */
+  for (vout = 0; out_count > 0; out_count--, vout++)
+  {
+    proto_item   *ti;
+    proto_tree   *subtree;
+    guint64       script_length;
+    guint8        script_type;
+    guint32       out_pos = pos;
+    guint64       value;
+
+    bitcoin_tx_need(tx_length, pos, 8);
+    value = pletoh64(data + pos);
+    pos  += 8;
+
+    field = pos;
+    bitcoin_tx_varint(data, tx_length, &pos, &script_length);
+    bitcoin_tx_need(tx_length, pos, script_length);
+
+    ti = proto_tree_add_item(tree, hf_msg_tx_out, tvb, start + out_pos,
+                             (pos - out_pos) + (guint)script_length, ENC_NA);
+    subtree = proto_item_add_subtree(ti, ett_tx_out_list);
+
+    proto_tree_add_uint64(subtree, hf_msg_tx_out_value, tvb, start + out_pos, 8, value);
+    out_value += value;
+
+    add_varint_item(subtree, tvb, start + field, pos - field, script_length, hf_msg_tx_out_script8, hf_msg_tx_out_script16,
+                    hf_msg_tx_out_script32, hf_msg_tx_out_script64);
+
+    proto_tree_add_bytes(subtree, hf_msg_tx_out_script, tvb, start + pos, (guint)script_length, data + pos);
+
+    if (bitcoin_outpoint_index)
+    {
+      script_type = get_bitcoin_script_type(tvb, start + pos, script_length);
+
+      ti = proto_tree_add_uint(subtree, hf_msg_tx_out_script_type, tvb, start + pos, (guint)script_length, script_type);
+      PROTO_ITEM_SET_GENERATED(ti);
+
+      if (have_txid && !pinfo->fd->flags.visited)
+        outpoint_table_insert(txid, vout, pinfo, value, script_type);
+    }
+    pos += (guint32)script_length;
+  }
+
+  /* Witness[], one stack per input
+   *   [1+]  item count         var_int
+   *   [ ?]  items, each a var_int length and that many bytes
+   */
+  if (layout.witness)
+  {
+    for (; inputs > 0; inputs--)
+    {
+      proto_item *ti;
+      proto_tree *subtree;
+      guint64     item_count;
+      guint64     item_length;
+      guint32     wit_pos = pos;
+
+      ti = proto_tree_add_item(tree, hf_msg_tx_witness, tvb, start + wit_pos, -1, ENC_NA);
+      subtree = proto_item_add_subtree(ti, ett_tx_witness);
+
+      field = pos;
+      bitcoin_tx_varint(data, tx_length, &pos, &item_count);
+      proto_tree_add_uint64(subtree, hf_msg_tx_witness_count, tvb, start + field, pos - field, item_count);
+
+      for (; item_count > 0; item_count--)
+      {
+        bitcoin_tx_varint(data, tx_length, &pos, &item_length);
+        bitcoin_tx_need(tx_length, pos, item_length);
+        proto_tree_add_bytes(subtree, hf_msg_tx_witness_item, tvb, start + pos, (guint)item_length, data + pos);
+        pos += (guint32)item_length;
+      }
+
+      proto_item_set_len(ti, pos - wit_pos);
+    }
+  }
+
+  bitcoin_tx_need(tx_length, pos, 4);
+  proto_tree_add_uint(tree, hf_msg_tx_lock_time, tvb, start + pos, 4, pletohl(data + pos));
+  pos += 4;
+
+  /* the fee is known once every spent output was seen earlier in the capture */
+  if (bitcoin_outpoint_index && have_txid && have_in_value && in_value >= out_value)
+  {
+    guint32 weight = get_bitcoin_tx_stripped_size(&layout) * 3 + pos;
+
+    dissect_bitcoin_tx_fee(tvb, start, pos, (weight + 3) / 4, pinfo, tree, txid, in_value - out_value,
+                           parents, parent_count, msgnum);
+  }
+
+  /* needed for block nesting */
+  proto_item_set_len(rti, pos);
+
+  return start + pos;
+}
+
+/**
+ * Note the first relay of a tx
+ */
+static bitcoin_tx_seen_t *
+bitcoin_tx_seen_add(guint64 key, packet_info *pinfo)
+{
+  bitcoin_tx_seen_t *seen;
+
+  seen = (bitcoin_tx_seen_t *)g_hash_table_lookup(tx_seen_table, &key);
+  if (!seen)
+  {
+    seen = g_new(bitcoin_tx_seen_t, 1);
+    seen->txid        = key;
+    seen->first_frame = pinfo->fd->num;
+    bitcoin_budget_insert(BITCOIN_STATE_TX_SEEN, &seen->txid, seen, pinfo);
+  }
+
+  return seen;
+}
+
+/**
+ * Check a relayed tx against the ones already seen in the capture
+ */
+static void
+dissect_bitcoin_tx_duplicate(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, const guint8 *txid)
+{
+  bitcoin_tx_seen_t *seen;
+  proto_item        *ti;
+  guint64            key = pletoh64(txid);
+
+  seen = (bitcoin_tx_seen_t *)g_hash_table_lookup(tx_seen_table, &key);
+  if (!seen && !pinfo->fd->flags.visited)
+    seen = bitcoin_tx_seen_add(key, pinfo);
+
+  /* evicted, and seen again only later in the capture */
+  if (!seen || seen->first_frame > pinfo->fd->num)
+    return;
+
+  if (seen->first_frame != pinfo->fd->num)
+  {
+    ti = proto_tree_add_uint(tree, hf_msg_tx_duplicate_of, tvb, 0, 0, seen->first_frame);
+    PROTO_ITEM_SET_GENERATED(ti);
+    expert_add_info_format(pinfo, ti, PI_SEQUENCE, PI_NOTE,
+                           "Transaction already relayed in frame %u", seen->first_frame);
+  }
+
+  if (have_tap_listener(bitcoin_tap))
+  {
+    bitcoin_tap_info_t *tap_info;
+
+    tap_info = ep_new0(bitcoin_tap_info_t);
+    tap_info->type      = BITCOIN_TAP_RELAY;
+    tap_info->size      = tvb_reported_length(tvb);
+    tap_info->duplicate = seen->first_frame != pinfo->fd->num;
+    tap_queue_packet(bitcoin_tap, pinfo, tap_info);
+  }
+}
+
+/**
+ * Handler for tx message
+ */
+static void
+dissect_bitcoin_msg_tx(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
+{
+  guint8              txid[32];
+  gboolean            have_txid = FALSE;
+  bitcoin_tx_layout_t layout;
+
+  /* the payload is exactly one tx, so hash it once here for everybody */
+  if (bitcoin_track_duplicates || bitcoin_outpoint_index || bitcoin_track_getdata || bitcoin_object_index ||
+      have_tap_listener(bitcoin_eo_tap))
+  {
+    if (get_bitcoin_tx_layout(tvb, 0, &layout) > 0)
+    {
+      get_bitcoin_txid(tvb, 0, &layout, txid);
+      have_txid = TRUE;
+    }
+  }
+
+  if (have_txid && have_tap_listener(bitcoin_eo_tap))
+    bitcoin_eo_queue(tvb, pinfo, "tx", txid);
+
+  if (bitcoin_track_duplicates && have_txid)
+    dissect_bitcoin_tx_duplicate(tvb, pinfo, tree, txid);
+
+  if (bitcoin_object_index && have_txid && !pinfo->fd->flags.visited)
+    bitcoin_tx_seen_add(pletoh64(txid), pinfo);
+
+  if (have_txid)
+    bitcoin_info_detail(bitcoin_hash_to_str(txid));
+
+  if (bitcoin_track_getdata && have_txid)
+  {
+    dissect_bitcoin_getdata_answer(tvb, 0, -1, pinfo, tree, pletoh64(txid), FALSE);
+
+    /* a MSG_WTX request for a tx without witness asked for its txid */
+    if (layout.witness)
+    {
+      guint8 wtxid[32];
+
+      get_bitcoin_wtxid(tvb, 0, &layout, wtxid);
+      dissect_bitcoin_getdata_answer(tvb, 0, -1, pinfo, tree, pletoh64(wtxid), FALSE);
+    }
+    dissect_bitcoin_getdata_inflight(tvb, pinfo, tree);
+  }
+
+  if (!tree && !bitcoin_outpoint_index)
+    return;
+
+  dissect_bitcoin_msg_tx_common(tvb, 0, pinfo, tree, 0, have_txid ? txid : NULL);
+}
+
+
+/**
+ * Dissect the block header and, unless count is NULL, the transaction count
+ */
+static guint32
+dissect_bitcoin_block_header(tvbuff_t *tvb, guint32 offset, proto_tree *tree, const guint8 *hash, guint64 *count)
+{
+  gint          length;
+  proto_item   *ti;
+  guint8        computed_hash[32];
+  guint8        reversed[32];
+  const guint8 *header = tvb_get_ptr(tvb, offset, 80);
+  nstime_t      timestamp;
+
+  if (tree)
+  {
+    if (!hash)
+    {
+      get_bitcoin_hash(tvb, offset, 80, computed_hash);
+      hash = computed_hash;
+    }
+    bitcoin_hash_reverse(hash, reversed);
+    ti = proto_tree_add_bytes(tree, hf_msg_block_hash, tvb, offset, 80, reversed);
+    PROTO_ITEM_SET_GENERATED(ti);
+  }
+
+  proto_tree_add_uint(tree, hf_msg_block_version,     tvb, offset,  4, pletohl(header));
+  offset += 4;
+
+  add_hash_item_ptr(tree, tvb, offset, hf_msg_block_prev_block, header + 4);
+  offset += 32;
+
+  add_hash_item_ptr(tree, tvb, offset, hf_msg_block_merkle_root, header + 36);
+  offset += 32;
+
+  timestamp.secs  = pletohl(header + 68);
+  timestamp.nsecs = 0;
+  proto_tree_add_time(tree, hf_msg_block_time,        tvb, offset,  4, &timestamp);
+  offset += 4;
+
+  proto_tree_add_uint(tree, hf_msg_block_bits,        tvb, offset,  4, pletohl(header + 72));
+  offset += 4;
+
+  proto_tree_add_uint(tree, hf_msg_block_nonce,       tvb, offset,  4, pletohl(header + 76));
+  offset += 4;
+
+  if (!count)
+    return offset;
+
+  get_varint(tvb, offset, &length, count);
+  add_varint_item(tree, tvb, offset, length, *count, hf_msg_block_transactions8, hf_msg_block_transactions16,
+                  hf_msg_block_transactions32, hf_msg_block_transactions64);
+
+  offset += length;
+
+  return offset;
+}
+
+/**
+ * Handler for block messages
+ */
+
+static void
+dissect_bitcoin_msg_block(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
+{
+  proto_item *ti;
+  guint64     count;
+  guint       msgnum;
+  guint32     offset = 0;
+  guint8      hash[32];
+  gboolean    have_hash = FALSE;
+
+  if ((info_tally || tree || bitcoin_header_chain || bitcoin_block_propagation || bitcoin_track_getdata ||
+       bitcoin_object_index || have_tap_listener(bitcoin_eo_tap)) && tvb_bytes_exist(tvb, 0, 80))
+  {
+    get_bitcoin_hash(tvb, 0, 80, hash);
+    have_hash = TRUE;
+    bitcoin_info_detail(bitcoin_hash_to_str(hash));
+  }
+
+  if (have_hash && have_tap_listener(bitcoin_eo_tap))
+    bitcoin_eo_queue(tvb, pinfo, "block", hash);
+
+  if (bitcoin_object_index && have_hash && !pinfo->fd->flags.visited)
+    bitcoin_block_received(pletoh64(hash), pinfo);
+
+  if (bitcoin_header_chain && have_hash && !pinfo->fd->flags.visited)
+  {
+    gint    length;
+    guint32 height = BITCOIN_HEIGHT_UNKNOWN;
+
+    if (try_get_varint(tvb, 80, &length, &count) && count > 0)
+      height = get_bitcoin_coinbase_height(tvb, 80 + length);
+    bitcoin_chain_add(tvb, 0, hash, height, pinfo);
+  }
+
+  if (!tree && (!bitcoin_outpoint_index || bitcoin_block_header_only))
+  {
+    if (bitcoin_block_propagation && have_hash)
+      dissect_bitcoin_block_prop(tvb, pinfo, NULL, pletoh64(hash));
+    if (bitcoin_track_getdata && have_hash)
+      dissect_bitcoin_getdata_answer(tvb, 0, 80, pinfo, NULL, pletoh64(hash), FALSE);
+    return;
+  }
+
+  /*  Block
+   *    [ 4] version         uint32_t
+   *    [32] prev_block      char[32]
+   *    [32] merkle_root     char[32]
+   *    [ 4] timestamp       uint32_t  A unix timestamp ... (Currently limited to dates before the year 2106!)
+   *    [ 4] bits            uint32_t
+   *    [ 4] nonce           uint32_t
+   *    [ ?] txn_count       var_int
+   *    [ ?] txns            tx[]      Block transactions, in format of "tx" command
+   */
+
+  ti   = proto_tree_add_item(tree, hf_bitcoin_msg_block, tvb, offset, -1, ENC_NA);
+  tree = proto_item_add_subtree(ti, ett_bitcoin_msg);
+
+  offset = dissect_bitcoin_block_header(tvb, offset, tree, have_hash ? hash : NULL, &count);
+  if (have_hash)
+  {
+    dissect_bitcoin_chain_info(tvb, 0, pinfo, tree, hash);
+    if (bitcoin_block_propagation)
+      dissect_bitcoin_block_prop(tvb, pinfo, tree, pletoh64(hash));
+    if (bitcoin_track_getdata)
+    {
+      dissect_bitcoin_getdata_answer(tvb, 0, 80, pinfo, tree, pletoh64(hash), FALSE);
+      dissect_bitcoin_getdata_inflight(tvb, pinfo, tree);
+    }
+  }
+
+  if (bitcoin_block_header_only)
+  {
+    if (count > 0)
+    {
+      ti = proto_tree_add_item(tree, hf_msg_block_txs_skipped, tvb, offset, -1, ENC_NA);
+      PROTO_ITEM_SET_GENERATED(ti);
+    }
+    return;
+  }
+
+  msgnum = 0;
+  for (; count > 0; count--)
+  {
+    msgnum += 1;
+    offset = dissect_bitcoin_msg_tx_common(tvb, offset, pinfo, tree, msgnum, NULL);
+  }
+}
+
+/**
+ * Handler for headers messages
+ */
+static void
+dissect_bitcoin_msg_headers(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
+{
+  proto_item *ti;
+  proto_tree *subtree;
+  gint        length;
+  guint64     count;
+  guint64     txs;
+  guint32     offset = 0;
+  guint8      hash[32];
+
+  if (!tree && !bitcoin_header_chain && !bitcoin_block_propagation)
+    return;
+
+  ti   = proto_tree_add_item(tree, hf_bitcoin_msg_headers, tvb, offset, -1, ENC_NA);
+  tree = proto_item_add_subtree(ti, ett_bitcoin_msg);
+
+  get_varint(tvb, offset, &length, &count);
+  add_varint_item(tree, tvb, offset, length, count, hf_msg_headers_count8, hf_msg_headers_count16,
+                  hf_msg_headers_count32, hf_msg_headers_count64);
+
+  /* BIP 130: up to 8 new blocks are announced this way to a peer that sent sendheaders */
+  if (tree && count > 0 && count <= 8)
+  {
+    bitcoin_conv_info_t *conv_info = get_bitcoin_conv_info(pinfo);
+
+    if (bitcoin_feature_active(conv_info, 1 - get_bitcoin_direction(conv_info, pinfo),
+                               BITCOIN_FEATURE_SENDHEADERS, pinfo))
+    {
+      ti = proto_tree_add_boolean(tree, hf_msg_headers_announcement, tvb, offset, length, TRUE);
+      PROTO_ITEM_SET_GENERATED(ti);
+    }
+  }
+
+  offset += length;
+
+  for (; count > 0; count--)
+  {
+    /* each header is followed by a tx count, which is always 0 */
+    get_varint(tvb, offset + 80, &length, &txs);
+    get_bitcoin_hash(tvb, offset, 80, hash);
+
+    if (bitcoin_header_chain && !pinfo->fd->flags.visited)
+      bitcoin_chain_add(tvb, offset, hash, BITCOIN_HEIGHT_UNKNOWN, pinfo);
+    if (bitcoin_block_propagation && !pinfo->fd->flags.visited)
+      bitcoin_block_announced(pletoh64(hash), pinfo);
+
+    ti      = proto_tree_add_item(tree, hf_msg_headers_header, tvb, offset, 80 + length, ENC_NA);
+    subtree = proto_item_add_subtree(ti, ett_headers_list);
+
+    dissect_bitcoin_block_header(tvb, offset, subtree, hash, &txs);
+    dissect_bitcoin_chain_info(tvb, offset, pinfo, subtree, hash);
+    offset += 80 + length;
+  }
+}
+
+/**
+ * Handler for cmpctblock messages (BIP 152)
+ */
+static void
+dissect_bitcoin_msg_cmpctblock(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
+{
+  proto_item          *ti;
+  gint                 length;
+  guint64              count;
+  guint32              offset = 0;
+  guint8               hash[32];
+  bitcoin_conv_info_t *conv_info;
+
+  if (!tree && !info_tally && !bitcoin_header_chain && !bitcoin_block_propagation && !bitcoin_track_getdata)
+    return;
+
+  get_bitcoin_hash(tvb, offset, 80, hash);
+  bitcoin_info_detail(bitcoin_hash_to_str(hash));
+
+  if (!pinfo->fd->flags.visited)
+  {
+    if (bitcoin_header_chain)
+      bitcoin_chain_add(tvb, offset, hash, BITCOIN_HEIGHT_UNKNOWN, pinfo);
+    if (bitcoin_block_propagation)
+      bitcoin_block_announced(pletoh64(hash), pinfo);
+  }
+
+  if (bitcoin_track_getdata && !tree)
+    dissect_bitcoin_getdata_answer(tvb, 0, 80, pinfo, NULL, pletoh64(hash), FALSE);
+
+  if (!tree)
+    return;
+
+  /*  Cmpctblock
+   *    [80] header           block header, without the tx count
+   *    [ 8] nonce            uint64_t
+   *    [ ?] shortids_length  var_int
+   *    [ ?] shortids         6 byte short tx ids
+   *    [ ?] prefilled_length var_int
+   *    [ ?] prefilledtxn     differentially encoded index and tx
+   */
+  ti   = proto_tree_add_item(tree, hf_bitcoin_msg_cmpctblock, tvb, offset, -1, ENC_NA);
+  tree = proto_item_add_subtree(ti, ett_bitcoin_msg);
+
+  /* BIP 152: sent unsolicited to a peer that asked for high-bandwidth mode */
+  conv_info = get_bitcoin_conv_info(pinfo);
+  if (bitcoin_feature_active(conv_info, 1 - get_bitcoin_direction(conv_info, pinfo),
+                             BITCOIN_FEATURE_SENDCMPCT_HB, pinfo))
+  {
+    ti = proto_tree_add_boolean(tree, hf_msg_cmpctblock_high_bandwidth, tvb, 0, 0, TRUE);
+    PROTO_ITEM_SET_GENERATED(ti);
+  }
+
+  offset = dissect_bitcoin_block_header(tvb, offset, tree, hash, NULL);
+  dissect_bitcoin_chain_info(tvb, 0, pinfo, tree, hash);
+  if (bitcoin_track_getdata)
+  {
+    dissect_bitcoin_getdata_answer(tvb, 0, 80, pinfo, tree, pletoh64(hash), FALSE);
+    dissect_bitcoin_getdata_inflight(tvb, pinfo, tree);
+  }
+
+  proto_tree_add_item(tree, hf_msg_cmpctblock_nonce, tvb, offset, 8, ENC_LITTLE_ENDIAN);
+  offset += 8;
+
+  get_varint(tvb, offset, &length, &count);
+  add_varint_item(tree, tvb, offset, length, count, hf_msg_cmpctblock_shortids8, hf_msg_cmpctblock_shortids16,
+                  hf_msg_cmpctblock_shortids32, hf_msg_cmpctblock_shortids64);
+  offset += length;
+
+  if (count > 0)
+  {
+    if (count > G_MAXINT / 6 || (offset + count * 6) > G_MAXINT)
+      THROW(ReportedBoundsError);
+    proto_tree_add_item(tree, hf_msg_cmpctblock_shortid_list, tvb, offset, (gint)count * 6, ENC_NA);
+    offset += (guint32)count * 6;
+  }
+
+  get_varint(tvb, offset, &length, &count);
+  add_varint_item(tree, tvb, offset, length, count, hf_msg_cmpctblock_prefilled8, hf_msg_cmpctblock_prefilled16,
+                  hf_msg_cmpctblock_prefilled32, hf_msg_cmpctblock_prefilled64);
+}
+
+/**
+ * Handler for verack messages
+ */
+static void
+dissect_bitcoin_msg_verack(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
+{
+  dissect_bitcoin_negotiation(tvb, pinfo, tree, BITCOIN_FEATURE_VERACK);
+}
+
+/**
+ * Handler for sendheaders messages (BIP 130)
+ */
+static void
+dissect_bitcoin_msg_sendheaders(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
+{
+  dissect_bitcoin_negotiation(tvb, pinfo, tree, BITCOIN_FEATURE_SENDHEADERS);
+}
+
+/**
+ * Handler for wtxidrelay messages (BIP 339)
+ */
+static void
+dissect_bitcoin_msg_wtxidrelay(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
+{
+  dissect_bitcoin_negotiation(tvb, pinfo, tree, BITCOIN_FEATURE_WTXIDRELAY);
+}
+
+/**
+ * Handler for sendaddrv2 messages (BIP 155)
+ */
+static void
+dissect_bitcoin_msg_sendaddrv2(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
+{
+  dissect_bitcoin_negotiation(tvb, pinfo, tree, BITCOIN_FEATURE_SENDADDRV2);
+}
+
+/**
+ * Handler for feefilter messages (BIP 133)
+ */
+static void
+dissect_bitcoin_msg_feefilter(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
+{
+  proto_item *ti;
+
+  ti   = proto_tree_add_item(tree, hf_bitcoin_msg_feefilter, tvb, 0, -1, ENC_NA);
+  tree = proto_item_add_subtree(ti, ett_bitcoin_msg);
+
+  proto_tree_add_item(tree, hf_msg_feefilter_feerate, tvb, 0, 8, ENC_LITTLE_ENDIAN);
+
+  dissect_bitcoin_negotiation(tvb, pinfo, tree, BITCOIN_FEATURE_FEEFILTER);
+}
+
+/**
+ * Handler for sendcmpct messages (BIP 152)
+ */
+static void
+dissect_bitcoin_msg_sendcmpct(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
+{
+  proto_item *ti;
+
+  ti   = proto_tree_add_item(tree, hf_bitcoin_msg_sendcmpct, tvb, 0, -1, ENC_NA);
+  tree = proto_item_add_subtree(ti, ett_bitcoin_msg);
+
+  proto_tree_add_item(tree, hf_msg_sendcmpct_announce, tvb, 0, 1, ENC_LITTLE_ENDIAN);
+  proto_tree_add_item(tree, hf_msg_sendcmpct_version,  tvb, 1, 8, ENC_LITTLE_ENDIAN);
+
+  if (!pinfo->fd->flags.visited)
+  {
+    bitcoin_conv_info_t *conv_info = get_bitcoin_conv_info(pinfo);
+
+    bitcoin_sendcmpct_announce(conv_info, get_bitcoin_direction(conv_info, pinfo),
+                               tvb_get_guint8(tvb, 0) != 0, pinfo);
+  }
+
+  dissect_bitcoin_negotiation(tvb, pinfo, tree, BITCOIN_FEATURE_SENDCMPCT);
+  if (tvb_get_guint8(tvb, 0))
+    dissect_bitcoin_negotiation(tvb, pinfo, NULL, BITCOIN_FEATURE_SENDCMPCT_HB);
+}
+
+/*
+ * Handler for ping messages
+ */
+static void
+dissect_bitcoin_msg_ping(tvbuff_t *tvb, packet_info *pinfo _U_, proto_tree *tree)
+{
+  proto_item *ti;
+  guint32     offset = 0;
+
+  if (!tree)
+    return;
+
+  ti   = proto_tree_add_item(tree, hf_bitcoin_msg_ping, tvb, offset, -1, ENC_NA);
+  tree = proto_item_add_subtree(ti, ett_ping);
+
+  proto_tree_add_item(tree, hf_msg_ping_nonce, tvb, offset, 8, ENC_LITTLE_ENDIAN);
+  offset += 8;
+
+}
+
+/*
+ * Handler for pong messages
+ */
+static void
+dissect_bitcoin_msg_pong(tvbuff_t *tvb, packet_info *pinfo _U_, proto_tree *tree)
+{
+  proto_item *ti;
+  guint32     offset = 0;
+
+  if (!tree)
+    return;
+
+  ti   = proto_tree_add_item(tree, hf_bitcoin_msg_pong, tvb, offset, -1, ENC_NA);
+  tree = proto_item_add_subtree(ti, ett_pong);
+
+  proto_tree_add_item(tree, hf_msg_pong_nonce, tvb, offset, 8, ENC_LITTLE_ENDIAN);
+  offset += 8;
+
+}
+
+/*
+ * Handler for reject messages
+ */
+static void
+dissect_bitcoin_msg_reject(tvbuff_t *tvb, packet_info *pinfo _U_, proto_tree *tree)
+{
+  proto_item *ti;
+  guint32     offset = 0;
+  gint        varint_length;
+  guint64     str_length;
+  //guint8      error_code;
+
+  if (!tree)
+    return;
+
+  ti   = proto_tree_add_item(tree, hf_bitcoin_msg_reject, tvb, offset, -1, ENC_NA);
+  tree = proto_item_add_subtree(ti, ett_reject);
+
+  /* find var_str user_agent */
+
+  get_varint(tvb, offset, &varint_length, &str_length);
+  offset += varint_length;
+
+  proto_tree_add_item(tree, hf_msg_reject_command, tvb, offset, str_length, ENC_ASCII|ENC_NA);
+  offset += str_length;
+
+  //error_code = tvb_get_guint8(tvb, offset);
+  proto_tree_add_item(tree, hf_msg_reject_code, tvb, offset, 1, ENC_LITTLE_ENDIAN);
+  offset ++;
+
+  get_varint(tvb, offset, &varint_length, &str_length);
+  offset += varint_length;
+
+  proto_tree_add_item(tree, hf_msg_reject_reason, tvb, offset, str_length, ENC_ASCII|ENC_NA);
+  offset += str_length;
+
+  add_hash_item(tree, tvb, offset, hf_msg_reject_hash);
+  offset += 32;
+}
+
+/*
+ * Handler for alert messages
+ */
+static void
+dissect_bitcoin_msg_alert(tvbuff_t *tvb, packet_info *pinfo _U_, proto_tree *tree)
+{
+  proto_item *ti;
+  guint32     offset = 0;
+  gint        varint_length;
+  guint64     msg_length,sig_length,set_length,str_length;
+  proto_tree  *subtree;
+
+  if (!tree)
+    return;
+
+  ti   = proto_tree_add_item(tree, hf_bitcoin_msg_alert, tvb, offset, -1, ENC_NA);
+  tree = proto_item_add_subtree(ti, ett_alert);
+
+  /* message portion*/
+  get_varint(tvb, offset, &varint_length, &msg_length);
+
+  ti   = proto_tree_add_item(tree, hf_msg_alert_message, tvb, offset, varint_length+msg_length, ENC_NA);
+  subtree = proto_item_add_subtree(ti, ett_alert_message);
+
+  add_varint_item(subtree, tvb, offset, varint_length, msg_length, hf_msg_alert_msg_length8, hf_msg_alert_msg_length16,
+                  hf_msg_alert_msg_length32, hf_msg_alert_msg_length64);
+  offset += varint_length;
+
+  // version 
+  proto_tree_add_item(subtree, hf_msg_alert_version,  tvb, offset,  4, ENC_LITTLE_ENDIAN);
+  offset += 4;
+
+  // times 
+  proto_tree_add_item(subtree, hf_msg_alert_relayuntil, tvb, offset, 8, ENC_TIME_TIMESPEC|ENC_LITTLE_ENDIAN);
+  offset += 8;
+  proto_tree_add_item(subtree, hf_msg_alert_expiration, tvb, offset, 8, ENC_TIME_TIMESPEC|ENC_LITTLE_ENDIAN);
+  offset += 8;
+
+  // id & cancel 
+  proto_tree_add_item(subtree, hf_msg_alert_id,  tvb, offset,  4, ENC_LITTLE_ENDIAN);
+  offset += 4;
+  proto_tree_add_item(subtree, hf_msg_alert_cancel,  tvb, offset,  4, ENC_LITTLE_ENDIAN);
+  offset += 4;
+
+  // cancel set 
+  get_varint(tvb, offset, &varint_length, &set_length);
+  add_varint_item(subtree, tvb, offset, varint_length, set_length, hf_msg_alert_cancel_set_count8, hf_msg_alert_cancel_set_count16,
+                  hf_msg_alert_cancel_set_count32, hf_msg_alert_cancel_set_count64);
+  offset += varint_length;
+
+  for (; set_length > 0; set_length--)
+  {
+    // **** should put this in a sub list
+    //subtree = proto_item_add_subtree(ti, ett_inv_list);
+
+    proto_tree_add_item(subtree, hf_msg_alert_cancel_set_item, tvb, offset, 4, ENC_LITTLE_ENDIAN);
+    offset += 4;
+  }
+
+  proto_tree_add_item(subtree, hf_msg_alert_min_version,  tvb, offset,  4, ENC_LITTLE_ENDIAN);
+  offset += 4;
+  proto_tree_add_item(subtree, hf_msg_alert_max_version,  tvb, offset,  4, ENC_LITTLE_ENDIAN);
+  offset += 4;
+
+
+  // subver set 
+  get_varint(tvb, offset, &varint_length, &set_length);
+  add_varint_item(subtree, tvb, offset, varint_length, set_length, hf_msg_alert_subver_set_count8, hf_msg_alert_subver_set_count16,
+                  hf_msg_alert_subver_set_count32, hf_msg_alert_subver_set_count64);
+  offset += varint_length;
+
+  for (; set_length > 0; set_length--)
+  {
+    // **** should put this in a sub list
+    //subtree = proto_item_add_subtree(ti, ett_inv_list);
+
+    guint64 subver_length;
+
+    get_varint(tvb, offset, &varint_length, &subver_length);
+    add_varint_item(subtree, tvb, offset, varint_length, subver_length,hf_msg_alert_subver_set_str_length8, 
+                          hf_msg_alert_subver_set_str_length16, 
+                          hf_msg_alert_subver_set_str_length32,hf_msg_alert_subver_set_str_length64); 
+    offset += varint_length;
+
+    proto_tree_add_item(subtree,hf_msg_alert_subver_set_string, tvb, offset, subver_length, ENC_ASCII|ENC_NA);
+    offset += subver_length;
+
+  }
+
+  // priority
+
+  proto_tree_add_item(subtree, hf_msg_alert_priority,  tvb, offset,  4, ENC_LITTLE_ENDIAN);
+  offset += 4;
+
+  // string messages -- comment
+    get_varint(tvb, offset, &varint_length, &str_length);
+    add_varint_item(subtree, tvb, offset, varint_length, str_length,hf_msg_alert_str_comment_length8, 
+                          hf_msg_alert_str_comment_length16, 
+                          hf_msg_alert_str_comment_length32,hf_msg_alert_str_comment_length64); 
+    offset += varint_length;
+
+    proto_tree_add_item(subtree,hf_msg_alert_str_comment, tvb, offset, str_length, ENC_ASCII|ENC_NA);
+    offset += str_length;
+
+  // string messages -- status bar
+    get_varint(tvb, offset, &varint_length, &str_length);
+    add_varint_item(subtree, tvb, offset, varint_length, str_length,hf_msg_alert_str_status_bar_length8, 
+                          hf_msg_alert_str_status_bar_length16, 
+                          hf_msg_alert_str_status_bar_length32,hf_msg_alert_str_status_bar_length64); 
+    offset += varint_length;
+
+    proto_tree_add_item(subtree,hf_msg_alert_str_status_bar, tvb, offset, str_length, ENC_ASCII|ENC_NA);
+    offset += str_length;
 
   // string messages -- reserved
     get_varint(tvb, offset, &varint_length, &str_length);
-    add_varint_item(subtree, tvb, offset, varint_length,hf_msg_alert_str_reserved_length8, 
+    add_varint_item(subtree, tvb, offset, varint_length, str_length,hf_msg_alert_str_reserved_length8, 
                           hf_msg_alert_str_reserved_length16, 
                           hf_msg_alert_str_reserved_length32,hf_msg_alert_str_reserved_length64); 
     offset += varint_length;
 
-    proto_tree_add_item(subtree,hf_msg_alert_str_reserved, tvb, offset, str_length, ENC_ASCII|ENC_NA);
-    offset += str_length;
+    proto_tree_add_item(subtree,hf_msg_alert_str_reserved, tvb, offset, str_length, ENC_ASCII|ENC_NA);
+    offset += str_length;
+
+  /* signature portion*/
+  ti   = proto_tree_add_item(tree, hf_msg_alert_signature, tvb, offset, -1, ENC_NA);
+  subtree = proto_item_add_subtree(ti, ett_alert_sig);
+  get_varint(tvb, offset, &varint_length, &sig_length);
+  offset += varint_length;
+  add_varint_item(subtree, tvb, offset, varint_length, sig_length, hf_msg_alert_signature_length8, hf_msg_alert_signature_length16,
+                  hf_msg_alert_signature_length32, hf_msg_alert_signature_length64);
+  proto_tree_add_item(subtree, hf_msg_alert_signature_data, tvb, offset, sig_length, ENC_NA);
+  offset += sig_length;
+}
+
+/**
+ * Handler for unimplemented or payload-less messages
+ */
+static void
+dissect_bitcoin_msg_empty(tvbuff_t *tvb _U_, packet_info *pinfo _U_, proto_tree *tree _U_)
+{
+  return;
+}
+
+typedef void (*msg_dissector_func_t)(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree);
+
+typedef struct msg_dissector
+{
+  const gchar *command;
+  msg_dissector_func_t function;
+} msg_dissector_t;
+
+static msg_dissector_t msg_dissectors[] =
+{
+  {"version",     dissect_bitcoin_msg_version},
+  {"addr",        dissect_bitcoin_msg_addr},
+  {"addrv2",      dissect_bitcoin_msg_addrv2},
+  {"inv",         dissect_bitcoin_msg_inv},
+  {"getdata",     dissect_bitcoin_msg_getdata},
+  {"notfound",    dissect_bitcoin_msg_notfound},
+  {"getblocks",   dissect_bitcoin_msg_getblocks},
+  {"getheaders",  dissect_bitcoin_msg_getheaders},
+  {"headers",     dissect_bitcoin_msg_headers},
+  {"cmpctblock",  dissect_bitcoin_msg_cmpctblock},
+  {"verack",      dissect_bitcoin_msg_verack},
+  {"sendheaders", dissect_bitcoin_msg_sendheaders},
+  {"wtxidrelay",  dissect_bitcoin_msg_wtxidrelay},
+  {"sendaddrv2",  dissect_bitcoin_msg_sendaddrv2},
+  {"feefilter",   dissect_bitcoin_msg_feefilter},
+  {"sendcmpct",   dissect_bitcoin_msg_sendcmpct},
+  {"tx",          dissect_bitcoin_msg_tx},
+  {"block",       dissect_bitcoin_msg_block},
+  {"ping",        dissect_bitcoin_msg_ping},
+  {"pong",        dissect_bitcoin_msg_pong},
+  {"reject",      dissect_bitcoin_msg_reject},
+  {"alert",       dissect_bitcoin_msg_alert},
+
+  /* messages with no payload */
+  {"getaddr",     dissect_bitcoin_msg_empty},
+  {"mempool",     dissect_bitcoin_msg_empty},
+
+  /* messages not implemented */
+  {"checkorder",  dissect_bitcoin_msg_empty},
+  {"submitorder", dissect_bitcoin_msg_empty},
+  {"reply",       dissect_bitcoin_msg_empty},
+  {"filterload",  dissect_bitcoin_msg_empty},
+  {"filteradd",   dissect_bitcoin_msg_empty},
+  {"filterclear", dissect_bitcoin_msg_empty},
+  {"merkleblock", dissect_bitcoin_msg_empty},
+};
+
+/**
+ * Add the protocol item and the message header fields
+ */
+static proto_tree *
+dissect_bitcoin_header(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, proto_item **pti)
+{
+  proto_item *ti;
+
+  col_set_str(pinfo->cinfo, COL_PROTOCOL, "Bitcoin");
+  col_clear(pinfo->cinfo, COL_INFO);
+
+  ti   = proto_tree_add_item(tree, proto_bitcoin, tvb, 0, -1, ENC_NA);
+  tree = proto_item_add_subtree(ti, ett_bitcoin);
+
+  /* add basic protocol data */
+  proto_tree_add_item(tree, hf_bitcoin_magic,   tvb,  0,  4, ENC_BIG_ENDIAN);
+  proto_tree_add_item(tree, hf_bitcoin_command, tvb,  4, 12, ENC_ASCII|ENC_NA);
+  proto_tree_add_item(tree, hf_bitcoin_length,  tvb, 16,  4, ENC_LITTLE_ENDIAN);
+  proto_tree_add_item(tree, hf_bitcoin_checksum, tvb, 20, 4, ENC_BIG_ENDIAN);
+
+  if (pti)
+    *pti = ti;
+
+  return tree;
+}
+
+/**
+ * Show the analysis state the message made room for, on every pass
+ */
+static void
+dissect_bitcoin_state_evicted(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
+{
+  bitcoin_frame_info_t *frame_info;
+  bitcoin_tap_info_t   *tap_info;
+  proto_item           *ti = NULL;
+  guint                 i;
+
+  frame_info = get_bitcoin_frame_info(pinfo, FALSE);
+  if (!frame_info || !frame_info->evicted || frame_info->evicted_msg != digest_msg)
+    return;
+
+  for (i = 0; i < BITCOIN_STATE_COUNT; i++)
+  {
+    if (frame_info->evicted[i] == 0)
+      continue;
+    ti = proto_tree_add_uint_format_value(tree, hf_bitcoin_state_evicted, tvb, 0, 0, frame_info->evicted[i],
+                                          "%u (%s)", frame_info->evicted[i], state_budgets[i].name);
+    PROTO_ITEM_SET_GENERATED(ti);
+  }
+
+  expert_add_info_format(pinfo, ti, PI_SEQUENCE, PI_NOTE,
+                         "Analysis state over bitcoin.state_budget, older cross-references dropped");
+
+  if (have_tap_listener(bitcoin_tap))
+  {
+    tap_info = ep_new0(bitcoin_tap_info_t);
+    tap_info->type    = BITCOIN_TAP_STATE;
+    tap_info->evicted = frame_info->evicted;
+    tap_queue_packet(bitcoin_tap, pinfo, tap_info);
+  }
+}
+
+/**
+ * Run a message handler, timing it for the bitcoin_perf tap
+ */
+static void
+dissect_bitcoin_timed(const msg_dissector_t *dissector, tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
+{
+  bitcoin_perf_t *perf;
+  gdouble         start;
+
+  perf = ep_new0(bitcoin_perf_t);
+  perf->command = dissector->command;
+  perf->bytes   = tvb_reported_length(tvb);
+  start = g_timer_elapsed(perf_timer, NULL);
+
+  /* malformed messages count as well */
+  TRY {
+    dissector->function(tvb, pinfo, tree);
+  }
+  FINALLY {
+    perf->usecs = (g_timer_elapsed(perf_timer, NULL) - start) * 1000000.0;
+    tap_queue_packet(bitcoin_perf_tap, pinfo, perf);
+  }
+  ENDTRY;
+}
+
+/**
+ * Hand the payload starting at offset to the handler of the command found
+ * at command_offset
+ */
+static void
+dissect_bitcoin_payload(tvbuff_t *tvb, gint command_offset, gint offset, packet_info *pinfo,
+                        proto_tree *tree, proto_item *ti)
+{
+  guint32 i;
+
+  bitcoin_digest_next_message(pinfo);
+
+  if (bitcoin_track_getdata && !pinfo->fd->flags.visited)
+    getdata_last_time = pinfo->fd->abs_ts;
+
+  /* handle command specific message part */
+  /* the command is NUL padded, so compare the terminator too; "addr"
+   * must not match "addrv2"
+   */
+  for (i = 0; i < array_length(msg_dissectors); i++)
+  {
+    if (tvb_memeql(tvb, command_offset, msg_dissectors[i].command,
+          strlen(msg_dissectors[i].command) + 1) == 0)
+    {
+      tvbuff_t *tvb_sub;
+
+      bitcoin_info_add(msg_dissectors[i].command);
+
+      tvb_sub = tvb_new_subset_remaining(tvb, offset);
+      if (have_tap_listener(bitcoin_perf_tap))
+        dissect_bitcoin_timed(&msg_dissectors[i], tvb_sub, pinfo, tree);
+      else
+        msg_dissectors[i].function(tvb_sub, pinfo, tree);
+      dissect_bitcoin_state_evicted(tvb_sub, pinfo, tree);
+      return;
+    }
+  }
+
+  /* no handler found */
+  bitcoin_info_add("[unknown command]");
+
+  expert_add_info_format(pinfo, ti, PI_MALFORMED, PI_ERROR, "Unknown command");
+}
+
+//////////////////////////////////
+////// dissect_bitcoin_tcp_pdu
+////// Main disector entry point after multiple pdus resolved
+////// 
+////// dissect packet
+//////////////////////////////////
+static void dissect_bitcoin_tcp_pdu(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
+{
+  proto_item *ti;
+  guint32     payload_length;
+
+  tree = dissect_bitcoin_header(tvb, pinfo, tree, &ti);
+
+  /* not reassembled, see get_bitcoin_pdu_length(); the rest of the payload
+   * is discarded from the following segments
+   */
+  payload_length = tvb_get_letohl(tvb, 16);
+  if (bitcoin_max_payload && payload_length > bitcoin_max_payload)
+  {
+    guint32 here = tvb_reported_length(tvb) > BITCOIN_HEADER_LENGTH ?
+                   tvb_reported_length(tvb) - BITCOIN_HEADER_LENGTH : 0;
+
+    bitcoin_info_add("[oversized message]");
+    expert_add_info_format(pinfo, ti, PI_MALFORMED, PI_ERROR,
+                           "Payload length %u exceeds the maximum of %u, not reassembled",
+                           payload_length, bitcoin_max_payload);
+
+    if (!pinfo->fd->flags.visited && payload_length > here)
+    {
+      bitcoin_conv_info_t *conv_info = get_bitcoin_conv_info(pinfo);
+
+      conv_info->oversized_left[get_bitcoin_direction(conv_info, pinfo)] = payload_length - here;
+    }
+    return;
+  }
+
+  /* TODO: verify checksum? */
+
+  dissect_bitcoin_payload(tvb, 4, BITCOIN_HEADER_LENGTH, pinfo, tree, ti);
+}
+
+/**
+ * Make room for length bytes in the stream buffer, keeping its first keep
+ */
+static guint8 *
+bitcoin_stream_buffer_reserve(bitcoin_stream_buffer_t *buffer, guint32 length, guint32 keep)
+{
+  if (length > buffer->size)
+  {
+    guint8 *data;
+
+    /* doubled, so an item growing by a segment at a time isn't copied
+     * each time
+     */
+    buffer->size = MAX(length, buffer->size * 2);
+    data = (guint8 *)se_alloc(buffer->size);
+    if (keep > 0)
+      memcpy(data, buffer->data, keep);
+    buffer->data = data;
+  }
+
+  return buffer->data;
+}
+
+/**
+ * Add a piece of exactly length bytes to a held-over item
+ */
+static bitcoin_carry_piece_t *
+bitcoin_carry_add(bitcoin_carry_piece_t *prev, const guint8 *data, guint32 length)
+{
+  bitcoin_carry_piece_t *piece;
+
+  piece = se_new(bitcoin_carry_piece_t);
+  piece->prev   = prev;
+  piece->length = length;
+  piece->data   = (guint8 *)se_memdup(data, length);
+
+  return piece;
+}
+
+/**
+ * Copy the length bytes of a held-over item ending with piece to buf
+ */
+static void
+bitcoin_carry_gather(const bitcoin_carry_piece_t *piece, guint32 length, guint8 *buf)
+{
+  for (; piece && piece->length <= length; piece = piece->prev)
+  {
+    length -= piece->length;
+    memcpy(buf + length, piece->data, piece->length);
+  }
+}
+
+/**
+ * Dissect the part of a streamed block message found in this segment
+ *
+ * Complete items (the block header and each tx) are dissected as they
+ * arrive; an item split across segments is held over in the stream state
+ * and prepended to the next segment, so at most one tx is ever buffered.
+ * buffer is the direction's stream buffer on the first pass, NULL after.
+ */
+static gint
+dissect_bitcoin_block_stream(tvbuff_t *tvb, gint offset, packet_info *pinfo, proto_tree *tree,
+                             bitcoin_stream_state_t *state, bitcoin_stream_buffer_t *buffer)
+{
+  proto_item *ti;
+  proto_tree *subtree;
+  tvbuff_t   *data_tvb;
+  guint32     avail;
+  guint32     data_length;
+  guint32     pos = 0;
+  guint32     tx_length;
+
+  avail = MIN((guint32)tvb_length_remaining(tvb, offset), state->pdu_left);
+
+  bitcoin_digest_next_message(pinfo);
+
+  /* merge the held-over partial item with this segment's bytes; on the
+   * first pass the item is already in the stream buffer and the segment is
+   * appended to it, later it is gathered from the pieces of the snapshot
+   */
+  if (state->carry_len > 0)
+  {
+    guint8 *buf;
+
+    data_length = state->carry_len + avail;
+    if (buffer)
+      buf = bitcoin_stream_buffer_reserve(buffer, data_length, state->carry_len);
+    else
+    {
+      buf = (guint8 *)ep_alloc(data_length);
+      bitcoin_carry_gather(state->carry, state->carry_len, buf);
+    }
+    tvb_memcpy(tvb, buf + state->carry_len, offset, avail);
+
+    data_tvb = tvb_new_child_real_data(tvb, buf, data_length, data_length);
+    add_new_data_source(pinfo, data_tvb, "Streamed block data");
+  }
+  else
+  {
+    data_length = avail;
+    data_tvb    = tvb_new_subset(tvb, offset, avail, avail);
+  }
 
-  /* signature portion*/
-  ti   = proto_tree_add_item(tree, hf_msg_alert_signature, tvb, offset, -1, ENC_NA);
-  subtree = proto_item_add_subtree(ti, ett_alert_sig);
-  get_varint(tvb, offset, &varint_length, &sig_length);
-  offset += varint_length;
-  add_varint_item(subtree, tvb, offset, varint_length, hf_msg_alert_signature_length8, hf_msg_alert_signature_length16,
-                  hf_msg_alert_signature_length32, hf_msg_alert_signature_length64);
-  proto_tree_add_item(subtree, hf_msg_alert_signature_data, tvb, offset, sig_length, ENC_NA);
-  offset += sig_length;
+  bitcoin_info_add("block (streamed)");
+
+  ti = proto_tree_add_item(tree, hf_bitcoin_msg_block, data_tvb, 0, -1, ENC_NA);
+  subtree = proto_item_add_subtree(ti, ett_bitcoin_msg);
+
+  if (!state->have_header)
+  {
+    gint    length;
+    guint64 count;
+
+    /* 80 byte header followed by the tx count */
+    if (try_get_varint(data_tvb, 80, &length, &count))
+    {
+      if (tree || bitcoin_header_chain || bitcoin_block_propagation || bitcoin_track_getdata ||
+          bitcoin_object_index)
+      {
+        guint8 hash[32];
+
+        get_bitcoin_hash(data_tvb, 0, 80, hash);
+        state->block_key = pletoh64(hash);
+        if (bitcoin_header_chain && !pinfo->fd->flags.visited)
+          bitcoin_chain_add(data_tvb, 0, hash, BITCOIN_HEIGHT_UNKNOWN, pinfo);
+        dissect_bitcoin_block_header(data_tvb, 0, subtree, hash, &count);
+        dissect_bitcoin_chain_info(data_tvb, 0, pinfo, subtree, hash);
+      }
+      pos = 80 + length;
+      state->have_header = TRUE;
+      state->tx_left     = bitcoin_block_header_only ? 0 : count;
+    }
+  }
+
+  /* the transactions just flow past */
+  if (state->have_header && bitcoin_block_header_only)
+    pos = data_length;
+
+  while (state->have_header && state->tx_left > 0 &&
+         (tx_length = get_bitcoin_tx_length(data_tvb, pos)) > 0)
+  {
+    state->tx_num  += 1;
+    state->tx_left -= 1;
+    if (tree || bitcoin_outpoint_index)
+      dissect_bitcoin_msg_tx_common(data_tvb, pos, pinfo, subtree, state->tx_num, NULL);
+    pos += tx_length;
+  }
+
+  state->pdu_left -= avail;
+
+  /* hold over whatever didn't form a complete item, adding only the bytes
+   * new to it as a piece: all of them for an item starting in this
+   * segment, this segment's if nothing of the merged buffer was consumed
+   */
+  if (buffer)
+  {
+    guint32 left = data_length - pos;
+
+    if (left == 0 || state->pdu_left == 0)
+      state->carry = NULL;
+    else if (pos > 0 || state->carry_len == 0)
+    {
+      state->carry = bitcoin_carry_add(NULL, tvb_get_ptr(data_tvb, pos, left), left);
+      memcpy(bitcoin_stream_buffer_reserve(buffer, left, 0), state->carry->data, left);
+    }
+    else if (avail > 0)
+      state->carry = bitcoin_carry_add(state->carry, tvb_get_ptr(tvb, offset, avail), avail);
+  }
+  state->carry_len = data_length - pos;
+
+  ti = proto_tree_add_uint(subtree, hf_msg_block_stream_start, tvb, 0, 0, state->first_frame);
+  PROTO_ITEM_SET_GENERATED(ti);
+
+  if (state->pdu_left > 0)
+  {
+    ti = proto_tree_add_uint(subtree, hf_msg_block_stream_pending, tvb, 0, 0, state->pdu_left);
+    PROTO_ITEM_SET_GENERATED(ti);
+  }
+  else
+  {
+    /* block level fields attach to the final segment */
+    proto_tree *stream_tree;
+
+    ti = proto_tree_add_text(subtree, tvb, 0, 0, "Streamed block complete");
+    PROTO_ITEM_SET_GENERATED(ti);
+    stream_tree = proto_item_add_subtree(ti, ett_block_stream);
+
+    ti = proto_tree_add_uint(stream_tree, hf_msg_block_stream_length, tvb, 0, 0, state->length);
+    PROTO_ITEM_SET_GENERATED(ti);
+    ti = proto_tree_add_uint(stream_tree, hf_msg_block_stream_txs, tvb, 0, 0, state->tx_num);
+    PROTO_ITEM_SET_GENERATED(ti);
+
+    if (!state->have_header || state->tx_left > 0 || state->carry_len > 0)
+      expert_add_info_format(pinfo, ti, PI_MALFORMED, PI_ERROR,
+                             "Block payload doesn't match its transaction count");
+    else
+    {
+      if (bitcoin_object_index && !pinfo->fd->flags.visited)
+        bitcoin_block_received(state->block_key, pinfo);
+      if (bitcoin_block_propagation)
+        dissect_bitcoin_block_prop(tvb, pinfo, stream_tree, state->block_key);
+      if (bitcoin_track_getdata)
+        dissect_bitcoin_getdata_answer(tvb, 0, 0, pinfo, stream_tree, state->block_key, FALSE);
+    }
+
+    memset(state, 0, sizeof(*state));
+  }
+
+  dissect_bitcoin_state_evicted(data_tvb, pinfo, subtree);
+
+  return offset + avail;
+}
+
+/**
+ * Discard the bytes at the start of a segment that belong to an oversized
+ * message seen earlier, the way the stream cursor tracks a block; returns
+ * how many there were
+ */
+static gint
+dissect_bitcoin_oversized(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
+{
+  bitcoin_conv_info_t  *conv_info = NULL;
+  bitcoin_frame_info_t *frame_info;
+  proto_item           *ti;
+  proto_tree           *subtree;
+  guint                 direction = 0;
+  guint32               left;
+  guint32               length;
+
+  /* snapshot the count on the first pass so we can redissect in any order */
+  if (!pinfo->fd->flags.visited)
+  {
+    conv_info = get_bitcoin_conv_info(pinfo);
+    direction = get_bitcoin_direction(conv_info, pinfo);
+    left      = conv_info->oversized_left[direction];
+    if (left == 0)
+      return 0;
+    frame_info = get_bitcoin_frame_info(pinfo, TRUE);
+    frame_info->oversized_left = left;
+  }
+  else
+  {
+    frame_info = get_bitcoin_frame_info(pinfo, FALSE);
+    if (!frame_info || frame_info->oversized_left == 0)
+      return 0;
+    left = frame_info->oversized_left;
+  }
+
+  length = MIN((guint32)tvb_reported_length(tvb), left);
+  if (conv_info)
+    conv_info->oversized_left[direction] = left - length;
+
+  col_set_str(pinfo->cinfo, COL_PROTOCOL, "Bitcoin");
+  bitcoin_info_add("[oversized message continued]");
+
+  ti      = proto_tree_add_item(tree, proto_bitcoin, tvb, 0, length, ENC_NA);
+  subtree = proto_item_add_subtree(ti, ett_bitcoin);
+  ti      = proto_tree_add_uint(subtree, hf_bitcoin_oversized_left, tvb, 0, length, left - length);
+  PROTO_ITEM_SET_GENERATED(ti);
+
+  return length;
+}
+
+/**
+ * Split the segment into messages ourselves so block messages can be
+ * dissected incrementally; everything else is reassembled as usual.
+ */
+static int
+dissect_bitcoin_stream(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
+{
+  bitcoin_conv_info_t    *conv_info;
+  bitcoin_stream_state_t *live;
+  bitcoin_stream_buffer_t *buffer = NULL;
+  bitcoin_frame_info_t   *frame_info;
+  bitcoin_stream_state_t  state;
+  gint                    offset = 0;
+  gint                    length;
+
+  conv_info = get_bitcoin_conv_info(pinfo);
+  live      = &conv_info->stream[get_bitcoin_direction(conv_info, pinfo)];
+  if (!pinfo->fd->flags.visited)
+    buffer = &conv_info->stream_buffer[get_bitcoin_direction(conv_info, pinfo)];
+
+  /* snapshot the cursor on the first pass so we can redissect in any order */
+  frame_info = get_bitcoin_frame_info(pinfo, TRUE);
+  if (!frame_info->have_stream)
+  {
+    frame_info->have_stream = TRUE;
+    frame_info->stream      = *live;
+  }
+  state = frame_info->stream;
+
+  if (state.pdu_left > 0)
+  {
+    proto_item *ti;
+    proto_tree *subtree;
+
+    col_set_str(pinfo->cinfo, COL_PROTOCOL, "Bitcoin");
+    col_clear(pinfo->cinfo, COL_INFO);
+
+    ti      = proto_tree_add_item(tree, proto_bitcoin, tvb, 0, MIN((guint32)tvb_length(tvb), state.pdu_left), ENC_NA);
+    subtree = proto_item_add_subtree(ti, ett_bitcoin);
+
+    offset = dissect_bitcoin_block_stream(tvb, offset, pinfo, subtree, &state, buffer);
+    col_set_fence(pinfo->cinfo, COL_INFO);
+  }
+
+  length = tvb_length(tvb);
+  while (offset < length)
+  {
+    gint  remaining = length - offset;
+    guint pdu_length;
+
+    if (remaining < BITCOIN_HEADER_LENGTH)
+    {
+      if (bitcoin_desegment && pinfo->can_desegment)
+      {
+        pinfo->desegment_offset = offset;
+        pinfo->desegment_len    = DESEGMENT_ONE_MORE_SEGMENT;
+        break;
+      }
+      dissect_bitcoin_tcp_pdu(tvb_new_subset_remaining(tvb, offset), pinfo, tree);
+      break;
+    }
+
+    pdu_length = get_bitcoin_pdu_length(pinfo, tvb, offset);
+    if (pdu_length <= (guint)remaining)
+    {
+      dissect_bitcoin_tcp_pdu(tvb_new_subset(tvb, offset, pdu_length, pdu_length), pinfo, tree);
+      offset += pdu_length;
+      col_set_fence(pinfo->cinfo, COL_INFO);
+      continue;
+    }
+
+    if (tvb_memeql(tvb, offset+4, "block", 6) == 0)
+    {
+      proto_tree *subtree;
+
+      subtree = dissect_bitcoin_header(tvb_new_subset_remaining(tvb, offset), pinfo, tree, NULL);
+
+      memset(&state, 0, sizeof(state));
+      state.first_frame = pinfo->fd->num;
+      state.length      = pdu_length - BITCOIN_HEADER_LENGTH;
+      state.pdu_left    = state.length;
+
+      offset = dissect_bitcoin_block_stream(tvb, offset + BITCOIN_HEADER_LENGTH, pinfo, subtree, &state, buffer);
+      break;
+    }
+
+    /* other messages are small enough to reassemble */
+    if (bitcoin_desegment && pinfo->can_desegment)
+    {
+      pinfo->desegment_offset = offset;
+      pinfo->desegment_len    = pdu_length - remaining;
+      break;
+    }
+    dissect_bitcoin_tcp_pdu(tvb_new_subset_remaining(tvb, offset), pinfo, tree);
+    break;
+  }
+
+  if (!pinfo->fd->flags.visited)
+    *live = state;
+
+  return length;
+}
+
+//////////////////////////////////
+////// dissect_bitcoin
+////// Main disector entry point
+////// 
+////// Assemble multiple protocol data units and pass on to single pdu handler
+//////
+////// This is what gets called when we "decode as" bitcoin or by the heuristic decoder if it
+////// detects we're a bitcoin pdu
+//////////////////////////////////
+static int
+dissect_bitcoin(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, void *data _U_)
+{
+  bitcoin_info_tally_t *tally = NULL;
+
+  /* collect the commands of all PDUs and fill the Info column once at the end */
+  if (pinfo->cinfo)
+    tally = ep_new0(bitcoin_info_tally_t);
+  info_tally = tally;
+
+  TRY {
+    gint skipped = dissect_bitcoin_oversized(tvb, pinfo, tree);
+
+    if (tvb_reported_length_remaining(tvb, skipped) > 0)
+    {
+      if (skipped > 0)
+        tvb = tvb_new_subset_remaining(tvb, skipped);
+
+      if (bitcoin_stream_blocks)
+        dissect_bitcoin_stream(tvb, pinfo, tree);
+      else
+        tcp_dissect_pdus(tvb, pinfo, tree, bitcoin_desegment, BITCOIN_HEADER_LENGTH,
+            get_bitcoin_pdu_length, dissect_bitcoin_tcp_pdu);
+    }
+  }
+  FINALLY {
+    info_tally = NULL;
+    if (tally)
+      bitcoin_info_render(pinfo, tally);
+  }
+  ENDTRY;
+
+  return tvb_reported_length(tvb);
+}
+
+//////////////////////////////////
+////// dissect_bitcoin_heur
+////// heuristic dissector entry point to detect we're a bitcoin pdu
+////// 
+//////////////////////////////////
+static gboolean
+dissect_bitcoin_heur(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, void *data _U_)
+{
+  guint32 magic_number;
+  conversation_t *conversation;
+
+  if (tvb_length(tvb) < 4)
+      return FALSE;
+
+  magic_number = tvb_get_letohl(tvb, 0);
+  if ((magic_number != BITCOIN_MAIN_MAGIC_NUMBER) &&
+      (magic_number != BITCOIN_TESTNET_MAGIC_NUMBER) &&
+      (magic_number != BITCOIN_TESTNET3_MAGIC_NUMBER) &&
+      (magic_number != LITECOIN_MAIN_MAGIC_NUMBER) &&
+      (magic_number != LITECOIN_TESTNET_MAGIC_NUMBER) &&
+      (magic_number != DOGECOIN_MAIN_MAGIC_NUMBER))
+     return FALSE;
+
+  /* Ok: This connection should always use the bitcoin dissector */
+  conversation = find_or_create_conversation(pinfo);
+  conversation_set_dissector(conversation, bitcoin_handle);
+
+  dissect_bitcoin(tvb, pinfo, tree, data);
+  return TRUE;
+}
+
+//////////////////////////////////
+////// dissect_bitcoin_capture_record
+////// dissector for one record of Bitcoin Core's -capturemessages
+////// files, wrapped in a DLT_USER packet
+//////////////////////////////////
+static int
+dissect_bitcoin_capture_record(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, void *data _U_)
+{
+  bitcoin_info_tally_t *tally = NULL;
+  proto_item           *ti;
+  tvbuff_t             *record_tvb;
+  guint64               usecs;
+  nstime_t              capture_time;
+  guint16               peer_port;
+  static const guint8   node_addr[16] = { 0 };
+
+  if (tvb_length(tvb) < BITCOIN_CAPTURE_PEER_LENGTH + BITCOIN_CAPTURE_HEADER_LENGTH ||
+      tvb_get_guint8(tvb, 18) > 1)
+    return 0;
+
+  col_set_str(pinfo->cinfo, COL_PROTOCOL, "Bitcoin");
+  col_clear(pinfo->cinfo, COL_INFO);
+
+  /* one conversation per peer with the node at [::]:0, so the analyses
+   * that tell the sides of a connection apart work as on the wire
+   */
+  peer_port = tvb_get_ntohs(tvb, 16);
+  pinfo->ptype = PT_TCP;
+  if (tvb_get_guint8(tvb, 18) == 0)
+  {
+    SET_ADDRESS(&pinfo->src, AT_IPv6, 16, tvb_get_ptr(tvb, 0, 16));
+    SET_ADDRESS(&pinfo->dst, AT_IPv6, 16, node_addr);
+    pinfo->srcport  = peer_port;
+    pinfo->destport = 0;
+    pinfo->p2p_dir  = P2P_DIR_RECV;
+  }
+  else
+  {
+    SET_ADDRESS(&pinfo->src, AT_IPv6, 16, node_addr);
+    SET_ADDRESS(&pinfo->dst, AT_IPv6, 16, tvb_get_ptr(tvb, 0, 16));
+    pinfo->srcport  = 0;
+    pinfo->destport = peer_port;
+    pinfo->p2p_dir  = P2P_DIR_SENT;
+  }
+
+  ti   = proto_tree_add_item(tree, proto_bitcoin, tvb, 0, -1, ENC_NA);
+  tree = proto_item_add_subtree(ti, ett_bitcoin);
+
+  proto_tree_add_item(tree, hf_bitcoin_capture_peer,      tvb,  0, 16, ENC_NA);
+  proto_tree_add_item(tree, hf_bitcoin_capture_peer_port, tvb, 16,  2, ENC_BIG_ENDIAN);
+  proto_tree_add_item(tree, hf_bitcoin_capture_direction, tvb, 18,  1, ENC_NA);
+
+  record_tvb = tvb_new_subset_remaining(tvb, BITCOIN_CAPTURE_PEER_LENGTH);
+
+  usecs = tvb_get_letoh64(record_tvb, 0);
+  capture_time.secs  = (time_t)(usecs / 1000000);
+  capture_time.nsecs = (int)(usecs % 1000000) * 1000;
+  proto_tree_add_time(tree, hf_bitcoin_capture_time, record_tvb, 0, 8, &capture_time);
+  proto_tree_add_item(tree, hf_bitcoin_command, record_tvb,  8, 12, ENC_ASCII|ENC_NA);
+  proto_tree_add_item(tree, hf_bitcoin_length,  record_tvb, 20,  4, ENC_LITTLE_ENDIAN);
+
+  if (pinfo->cinfo)
+    tally = ep_new0(bitcoin_info_tally_t);
+  info_tally = tally;
+
+  TRY {
+    dissect_bitcoin_payload(record_tvb, 8, BITCOIN_CAPTURE_HEADER_LENGTH, pinfo, tree, ti);
+  }
+  FINALLY {
+    info_tally = NULL;
+    if (tally)
+      bitcoin_info_render(pinfo, tally);
+  }
+  ENDTRY;
+
+  return tvb_reported_length(tvb);
+}
+
+//////////////////////////////////
+////// dissect_bitcoin_block_record
+////// dissector for one record of Bitcoin Core's blk?????.dat
+////// block files, wrapped in a DLT_USER packet
+//////////////////////////////////
+static int
+dissect_bitcoin_block_record(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, void *data _U_)
+{
+  bitcoin_info_tally_t *tally = NULL;
+  proto_item           *ti;
+
+  if (tvb_length(tvb) < BITCOIN_BLOCK_RECORD_HEADER_LENGTH ||
+      !try_val_to_str(tvb_get_ntohl(tvb, 0), magic_types))
+    return 0;
+
+  col_set_str(pinfo->cinfo, COL_PROTOCOL, "Bitcoin");
+  col_clear(pinfo->cinfo, COL_INFO);
+
+  ti   = proto_tree_add_item(tree, proto_bitcoin, tvb, 0, -1, ENC_NA);
+  tree = proto_item_add_subtree(ti, ett_bitcoin);
+
+  proto_tree_add_item(tree, hf_bitcoin_magic,  tvb, 0, 4, ENC_BIG_ENDIAN);
+  proto_tree_add_item(tree, hf_bitcoin_length, tvb, 4, 4, ENC_LITTLE_ENDIAN);
+
+  if (pinfo->cinfo)
+    tally = ep_new0(bitcoin_info_tally_t);
+  info_tally = tally;
+
+  TRY {
+    bitcoin_digest_next_message(pinfo);
+    bitcoin_info_add("block");
+    dissect_bitcoin_msg_block(tvb_new_subset_remaining(tvb, BITCOIN_BLOCK_RECORD_HEADER_LENGTH), pinfo, tree);
+    dissect_bitcoin_state_evicted(tvb, pinfo, tree);
+  }
+  FINALLY {
+    info_tally = NULL;
+    if (tally)
+      bitcoin_info_render(pinfo, tally);
+  }
+  ENDTRY;
+
+  return tvb_reported_length(tvb);
+}
+
+//////////////////////////////////
+////// stats trees
+////// 
+//////////////////////////////////
+/**
+ * Create the feerate buckets under a node, so they show in order
+ */
+static void
+bitcoin_feerate_stats_buckets(stats_tree *st, int parent)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS(feerate_buckets); i++)
+    stats_tree_create_node(st, feerate_buckets[i].name, parent, FALSE);
+}
+
+/**
+ * Count a feerate in its bucket under a node; the buckets compare the
+ * exact feerate, as ticking a range node would truncate it to an integer
+ */
+static void
+bitcoin_feerate_stats_tick(stats_tree *st, const gchar *name, int grandparent, int parent, gdouble feerate)
+{
+  guint i;
+
+  for (i = G_N_ELEMENTS(feerate_buckets) - 1; i > 0 && feerate < feerate_buckets[i].bound; i--)
+    ;
+  tick_stat_node(st, name, grandparent, TRUE);
+  tick_stat_node(st, feerate_buckets[i].name, parent, FALSE);
+}
+
+static void
+bitcoin_feerate_stats_tree_init(stats_tree *st)
+{
+  st_node_feerate = stats_tree_create_node(st, st_str_feerate, 0, TRUE);
+  bitcoin_feerate_stats_buckets(st, st_node_feerate);
+  st_node_feerate_by_minute = stats_tree_create_node(st, st_str_feerate_by_minute, 0, TRUE);
+}
+
+static int
+bitcoin_feerate_stats_tree_packet(stats_tree *st, packet_info *pinfo, epan_dissect_t *edt _U_, const void *p)
+{
+  const bitcoin_tap_info_t *tap_info = (const bitcoin_tap_info_t *)p;
+  guint                     minute;
+  int                       node;
+  gchar                    *name;
+
+  if (tap_info->type != BITCOIN_TAP_TX)
+    return 0;
+
+  bitcoin_feerate_stats_tick(st, st_str_feerate, 0, st_node_feerate, tap_info->feerate);
+
+  /* one node per minute since the start of the capture, found by name in
+   * the tree itself, so every open tree has its own
+   */
+  minute = (guint)(pinfo->rel_ts.secs / 60);
+  name   = ep_strdup_printf("Minute %u", minute);
+  node   = stats_tree_parent_id_by_name(st, name);
+  if (node == 0)
+  {
+    node = stats_tree_create_node(st, name, st_node_feerate_by_minute, TRUE);
+    bitcoin_feerate_stats_buckets(st, node);
+  }
+  tick_stat_node(st, st_str_feerate_by_minute, 0, TRUE);
+  bitcoin_feerate_stats_tick(st, name, st_node_feerate_by_minute, node, tap_info->feerate);
+
+  return 1;
+}
+
+static void
+bitcoin_relay_stats_tree_init(stats_tree *st)
+{
+  stats_tree_create_node(st, st_str_relay_txs, 0, FALSE);
+  stats_tree_create_node(st, st_str_relay_dups, 0, FALSE);
+  st_node_relay_bytes  = stats_tree_create_node(st, st_str_relay_bytes, 0, TRUE);
+  st_node_relay_wasted = stats_tree_create_node(st, st_str_relay_wasted, 0, TRUE);
+}
+
+static int
+bitcoin_relay_stats_tree_packet(stats_tree *st, packet_info *pinfo, epan_dissect_t *edt _U_, const void *p)
+{
+  const bitcoin_tap_info_t *tap_info = (const bitcoin_tap_info_t *)p;
+  const gchar              *peer;
+
+  if (tap_info->type != BITCOIN_TAP_RELAY)
+    return 0;
+
+  peer = ep_address_to_str(&pinfo->src);
+
+  tick_stat_node(st, st_str_relay_txs, 0, FALSE);
+  increase_stat_node(st, st_str_relay_bytes, 0, FALSE, tap_info->size);
+  increase_stat_node(st, peer, st_node_relay_bytes, FALSE, tap_info->size);
+
+  if (tap_info->duplicate)
+  {
+    tick_stat_node(st, st_str_relay_dups, 0, FALSE);
+    increase_stat_node(st, st_str_relay_wasted, 0, FALSE, tap_info->size);
+    increase_stat_node(st, peer, st_node_relay_wasted, FALSE, tap_info->size);
+  }
+
+  return 1;
+}
+
+static void
+bitcoin_addr_stats_tree_init(stats_tree *st)
+{
+  st_node_addr_msgs = stats_tree_create_range_node(st, st_str_addr_msgs, 0,
+      "1-1", "2-9", "10-99", "100-999", "1000-", NULL);
+  st_node_addr_entries = stats_tree_create_pivot(st, st_str_addr_entries, 0);
+  stats_tree_create_node(st, st_str_addr_new, 0, FALSE);
+  stats_tree_create_node(st, st_str_addr_new_relays, 0, FALSE);
+  st_node_addr_peers = stats_tree_create_pivot(st, st_str_addr_peers, 0);
+}
+
+static int
+bitcoin_addr_stats_tree_packet(stats_tree *st, packet_info *pinfo, epan_dissect_t *edt _U_, const void *p)
+{
+  const bitcoin_tap_info_t *tap_info = (const bitcoin_tap_info_t *)p;
+  guint                     i;
+
+  if (tap_info->type != BITCOIN_TAP_ADDR)
+    return 0;
+
+  stats_tree_tick_range(st, st_str_addr_msgs, 0, tap_info->addr_count);
+
+  for (i = 0; i < tap_info->addr_count; i++)
+  {
+    const bitcoin_tap_addr_t *addr = &tap_info->addrs[i];
+
+    stats_tree_tick_pivot(st, st_node_addr_entries,
+                          val_to_str_const(addr->network, addrv2_networks, "Unknown network"));
+    if (addr->is_new)
+      tick_stat_node(st, st_str_addr_new, 0, FALSE);
+    if (addr->new_relay)
+      tick_stat_node(st, st_str_addr_new_relays, 0, FALSE);
+  }
+
+  /* which peers the gossip comes from */
+  increase_stat_node(st, ep_address_to_str(&pinfo->src), st_node_addr_peers, FALSE, tap_info->addr_count);
+  increase_stat_node(st, st_str_addr_peers, 0, FALSE, tap_info->addr_count);
+
+  return 1;
 }
 
-/**
- * Handler for unimplemented or payload-less messages
- */
 static void
-dissect_bitcoin_msg_empty(tvbuff_t *tvb _U_, packet_info *pinfo _U_, proto_tree *tree _U_)
+bitcoin_blockprop_stats_tree_init(stats_tree *st)
 {
-  return;
+  stats_tree_create_node(st, st_str_blockprop_blocks, 0, FALSE);
+  st_node_blockprop_first = stats_tree_create_pivot(st, st_str_blockprop_first, 0);
+  stats_tree_create_range_node(st, st_str_blockprop_announce, 0,
+      "0-99", "100-499", "500-999", "1000-4999", "5000-29999", "30000-", NULL);
+  stats_tree_create_range_node(st, st_str_blockprop_delay, 0,
+      "0-0", "1-99", "100-499", "500-999", "1000-4999", "5000-29999", "30000-", NULL);
+  st_node_blockprop_by_peer = stats_tree_create_node(st, st_str_blockprop_by_peer, 0, TRUE);
+
+  if (st_blockprop_peers)
+    g_hash_table_destroy(st_blockprop_peers);
+  st_blockprop_peers = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
 }
 
-typedef void (*msg_dissector_func_t)(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree);
-
-typedef struct msg_dissector
+static int
+bitcoin_blockprop_stats_tree_packet(stats_tree *st, packet_info *pinfo, epan_dissect_t *edt _U_, const void *p)
 {
-  const gchar *command;
-  msg_dissector_func_t function;
-} msg_dissector_t;
+  const bitcoin_tap_info_t *tap_info = (const bitcoin_tap_info_t *)p;
+  const gchar              *peer;
 
-static msg_dissector_t msg_dissectors[] =
-{
-  {"version",     dissect_bitcoin_msg_version},
-  {"addr",        dissect_bitcoin_msg_addr},
-  {"inv",         dissect_bitcoin_msg_inv},
-  {"getdata",     dissect_bitcoin_msg_getdata},
-  {"notfound",    dissect_bitcoin_msg_notfound},
-  {"getblocks",   dissect_bitcoin_msg_getblocks},
-  {"getheaders",  dissect_bitcoin_msg_getheaders},
-  {"tx",          dissect_bitcoin_msg_tx},
-  {"block",       dissect_bitcoin_msg_block},
-  {"ping",        dissect_bitcoin_msg_ping},
-  {"pong",        dissect_bitcoin_msg_pong},
-  {"reject",      dissect_bitcoin_msg_reject},
-  {"alert",       dissect_bitcoin_msg_alert},
+  if (tap_info->type != BITCOIN_TAP_BLOCK)
+    return 0;
 
-  /* messages with no payload */
-  {"verack",      dissect_bitcoin_msg_empty},
-  {"getaddr",     dissect_bitcoin_msg_empty},
-  {"mempool",     dissect_bitcoin_msg_empty},
+  peer = ep_address_to_str(&pinfo->src);
 
-  /* messages not implemented */
-  {"headers",     dissect_bitcoin_msg_empty},
-  {"checkorder",  dissect_bitcoin_msg_empty},
-  {"submitorder", dissect_bitcoin_msg_empty},
-  {"reply",       dissect_bitcoin_msg_empty},
-  {"filterload",  dissect_bitcoin_msg_empty},
-  {"filteradd",   dissect_bitcoin_msg_empty},
-  {"filterclear", dissect_bitcoin_msg_empty},
-  {"merkleblock", dissect_bitcoin_msg_empty},
-};
+  if (tap_info->first_receipt)
+  {
+    tick_stat_node(st, st_str_blockprop_blocks, 0, FALSE);
+    stats_tree_tick_pivot(st, st_node_blockprop_first, peer);
+    if (tap_info->announce_delay >= 0)
+      stats_tree_tick_range(st, st_str_blockprop_announce, 0, (int)tap_info->announce_delay);
+  }
 
-//////////////////////////////////
-////// dissect_bitcoin_tcp_pdu
-////// Main disector entry point after multiple pdus resolved
-////// 
-////// dissect packet
-//////////////////////////////////
-static void dissect_bitcoin_tcp_pdu(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
-{
-  proto_item *ti;
-  guint32     i;
-  guint32     offset = 0;
+  stats_tree_tick_range(st, st_str_blockprop_delay, 0, (int)tap_info->first_delay);
 
-  col_set_str(pinfo->cinfo, COL_PROTOCOL, "Bitcoin");
-  col_clear(pinfo->cinfo, COL_INFO);
+  /* one range node per peer */
+  if (!g_hash_table_lookup(st_blockprop_peers, peer))
+  {
+    stats_tree_create_range_node(st, peer, st_node_blockprop_by_peer,
+        "0-0", "1-99", "100-499", "500-999", "1000-4999", "5000-29999", "30000-", NULL);
+    g_hash_table_insert(st_blockprop_peers, g_strdup(peer), GUINT_TO_POINTER(1));
+  }
+  tick_stat_node(st, st_str_blockprop_by_peer, 0, TRUE);
+  stats_tree_tick_range(st, peer, st_node_blockprop_by_peer, (int)tap_info->first_delay);
 
-  ti   = proto_tree_add_item(tree, proto_bitcoin, tvb, 0, -1, ENC_NA);
-  tree = proto_item_add_subtree(ti, ett_bitcoin);
+  return 1;
+}
 
-  /* add basic protocol data */
-  proto_tree_add_item(tree, hf_bitcoin_magic,   tvb,  0,  4, ENC_BIG_ENDIAN);
-  proto_tree_add_item(tree, hf_bitcoin_command, tvb,  4, 12, ENC_ASCII|ENC_NA);
-  proto_tree_add_item(tree, hf_bitcoin_length,  tvb, 16,  4, ENC_LITTLE_ENDIAN);
-  proto_tree_add_item(tree, hf_bitcoin_checksum, tvb, 20, 4, ENC_BIG_ENDIAN);
-  offset = BITCOIN_HEADER_LENGTH;
+static void
+bitcoin_perf_stats_tree_init(stats_tree *st)
+{
+  st_node_perf_msgs  = stats_tree_create_node(st, st_str_perf_msgs, 0, TRUE);
+  st_node_perf_bytes = stats_tree_create_node(st, st_str_perf_bytes, 0, TRUE);
+  st_node_perf_usecs = stats_tree_create_node(st, st_str_perf_usecs, 0, TRUE);
+
+  if (st_perf_usecs)
+    g_hash_table_destroy(st_perf_usecs);
+  st_perf_usecs = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, g_free);
+  st_perf_usecs_total = 0;
+}
 
-  /* TODO: verify checksum? */
+static int
+bitcoin_perf_stats_tree_packet(stats_tree *st, packet_info *pinfo _U_, epan_dissect_t *edt _U_, const void *p)
+{
+  const bitcoin_perf_t *perf = (const bitcoin_perf_t *)p;
+  gdouble              *usecs;
 
-  /* handle command specific message part */
-  for (i = 0; i < array_length(msg_dissectors); i++)
-  {
-    if (tvb_memeql(tvb, 4, msg_dissectors[i].command,
-          strlen(msg_dissectors[i].command)) == 0)
-    {
-      tvbuff_t *tvb_sub;
+  tick_stat_node(st, st_str_perf_msgs, 0, TRUE);
+  tick_stat_node(st, perf->command, st_node_perf_msgs, FALSE);
 
-      col_append_sep_str(pinfo->cinfo, COL_INFO, ", ", msg_dissectors[i].command);
+  increase_stat_node(st, st_str_perf_bytes, 0, TRUE, perf->bytes);
+  increase_stat_node(st, perf->command, st_node_perf_bytes, FALSE, perf->bytes);
 
-      tvb_sub = tvb_new_subset_remaining(tvb, offset);
-      msg_dissectors[i].function(tvb_sub, pinfo, tree);
-      return;
-    }
+  /* most handlers take well under a microsecond, so sum before rounding */
+  usecs = (gdouble *)g_hash_table_lookup(st_perf_usecs, perf->command);
+  if (!usecs)
+  {
+    usecs = g_new0(gdouble, 1);
+    g_hash_table_insert(st_perf_usecs, (gpointer)perf->command, usecs);
   }
+  *usecs              += perf->usecs;
+  st_perf_usecs_total += perf->usecs;
 
-  /* no handler found */
-  col_append_sep_str(pinfo->cinfo, COL_INFO, ", ", "[unknown command]");
+  set_stat_node(st, st_str_perf_usecs, 0, TRUE, (gint)(st_perf_usecs_total + 0.5));
+  set_stat_node(st, perf->command, st_node_perf_usecs, FALSE, (gint)(*usecs + 0.5));
 
-  expert_add_info_format(pinfo, ti, PI_MALFORMED, PI_ERROR, "Unknown command");
+  return 1;
 }
-//////////////////////////////////
-////// dissect_bitcoin
-////// Main disector entry point
-////// 
-////// Assemble multiple protocol data units and pass on to single pdu handler
-//////
-////// This is what gets called when we "decode as" bitcoin or by the heuristic decoder if it
-////// detects we're a bitcoin pdu
-//////////////////////////////////
+
+static void
+bitcoin_state_stats_tree_init(stats_tree *st)
+{
+  st_node_state_dropped = stats_tree_create_node(st, st_str_state_dropped, 0, TRUE);
+}
+
 static int
-dissect_bitcoin(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, void *data _U_)
+bitcoin_state_stats_tree_packet(stats_tree *st, packet_info *pinfo _U_, epan_dissect_t *edt _U_, const void *p)
 {
-  tcp_dissect_pdus(tvb, pinfo, tree, bitcoin_desegment, BITCOIN_HEADER_LENGTH,
-      get_bitcoin_pdu_length, dissect_bitcoin_tcp_pdu);
+  const bitcoin_tap_info_t *tap_info = (const bitcoin_tap_info_t *)p;
+  guint                     i;
 
-  return tvb_reported_length(tvb);
+  if (tap_info->type != BITCOIN_TAP_STATE)
+    return 0;
+
+  for (i = 0; i < BITCOIN_STATE_COUNT; i++)
+  {
+    if (tap_info->evicted[i] == 0)
+      continue;
+    increase_stat_node(st, st_str_state_dropped, 0, TRUE, tap_info->evicted[i]);
+    increase_stat_node(st, state_budgets[i].name, st_node_state_dropped, FALSE, tap_info->evicted[i]);
+  }
+
+  return 1;
 }
 
 //////////////////////////////////
-////// dissect_bitcoin_heur
-////// heuristic dissector entry point to detect we're a bitcoin pdu
+////// bitcoin_init
+////// reset the capture-wide state
 ////// 
 //////////////////////////////////
-static gboolean
-dissect_bitcoin_heur(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, void *data _U_)
+static void
+bitcoin_init(void)
 {
-  guint32 magic_number;
-  conversation_t *conversation;
+  guint i;
 
-  if (tvb_length(tvb) < 4)
-      return FALSE;
+  g_free(outpoint_table.slots);
+  memset(&outpoint_table, 0, sizeof(outpoint_table));
 
-  magic_number = tvb_get_letohl(tvb, 0);
-  if ((magic_number != BITCOIN_MAIN_MAGIC_NUMBER) &&
-      (magic_number != BITCOIN_TESTNET_MAGIC_NUMBER) &&
-      (magic_number != BITCOIN_TESTNET3_MAGIC_NUMBER) &&
-      (magic_number != LITECOIN_MAIN_MAGIC_NUMBER) &&
-      (magic_number != LITECOIN_TESTNET_MAGIC_NUMBER) &&
-      (magic_number != DOGECOIN_MAIN_MAGIC_NUMBER))
-     return FALSE;
+  g_free(header_chain.entries);
+  g_free(header_chain.index);
+  g_free(header_chain.fragments);
+  if (header_chain.waiting)
+    g_hash_table_destroy(header_chain.waiting);
+  memset(&header_chain, 0, sizeof(header_chain));
+  header_chain.waiting = g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free, NULL);
 
-  /* Ok: This connection should always use the bitcoin dissector */
-  conversation = find_or_create_conversation(pinfo);
-  conversation_set_dissector(conversation, bitcoin_handle);
+  if (tx_info_table)
+    g_hash_table_destroy(tx_info_table);
+  tx_info_table = g_hash_table_new_full(g_int64_hash, g_int64_equal, NULL, g_free);
 
-  dissect_bitcoin(tvb, pinfo, tree, data);
-  return TRUE;
+  if (tx_seen_table)
+    g_hash_table_destroy(tx_seen_table);
+  tx_seen_table = g_hash_table_new_full(g_int64_hash, g_int64_equal, NULL, g_free);
+
+
+  if (digest_cache_table)
+    g_hash_table_destroy(digest_cache_table);
+  digest_cache_table = g_hash_table_new_full(g_int64_hash, g_int64_equal, NULL, g_free);
+  digest_frame    = 0;
+  digest_msg      = 0;
+  digest_in_frame = FALSE;
+
+  if (!perf_timer)
+    perf_timer = g_timer_new();
+
+  if (addr_table)
+    g_hash_table_destroy(addr_table);
+  addr_table = g_hash_table_new_full(g_int64_hash, g_int64_equal, NULL, g_free);
+
+  if (addr_relay_table)
+    g_hash_table_destroy(addr_relay_table);
+  addr_relay_table = g_hash_table_new_full(g_int64_hash, g_int64_equal, NULL, g_free);
+
+  if (block_prop_table)
+    g_hash_table_destroy(block_prop_table);
+  block_prop_table = g_hash_table_new_full(g_int64_hash, g_int64_equal, NULL, g_free);
+
+  if (block_peer_table)
+    g_hash_table_destroy(block_peer_table);
+  block_peer_table = g_hash_table_new_full(g_int64_hash, g_int64_equal, NULL, g_free);
+
+  if (getdata_pending_table)
+    g_hash_table_destroy(getdata_pending_table);
+  getdata_pending_table = g_hash_table_new(g_int64_hash, g_int64_equal);
+
+  if (getdata_answer_table)
+    g_hash_table_destroy(getdata_answer_table);
+  getdata_answer_table = g_hash_table_new(g_int64_hash, g_int64_equal);
+
+  if (getdata_req_table)
+    g_hash_table_destroy(getdata_req_table);
+  getdata_req_table = g_hash_table_new_full(g_int64_hash, g_int64_equal, NULL, g_free);
+
+  nstime_set_zero(&getdata_last_time);
+
+  for (i = 0; i < BITCOIN_STATE_COUNT; i++)
+  {
+    if (state_budgets[i].order)
+      g_queue_free(state_budgets[i].order);
+    state_budgets[i].order = state_budgets[i].table ? g_queue_new() : NULL;
+  }
 }
 
 //////////////////////////////////
@@ -1310,6 +5836,25 @@ proto_register_bitcoin(void)
     { &hf_bitcoin_checksum,
       { "Payload checksum", "bitcoin.checksum", FT_UINT32, BASE_HEX, NULL, 0x0, NULL, HFILL }
     },
+    { &hf_bitcoin_oversized_left,
+      { "Oversized payload bytes still to come", "bitcoin.oversized_left", FT_UINT32, BASE_DEC, NULL, 0x0,
+        NULL, HFILL }
+    },
+    { &hf_bitcoin_capture_peer,
+      { "Peer address", "bitcoin.capture_peer", FT_IPv6, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_bitcoin_capture_peer_port,
+      { "Peer port", "bitcoin.capture_peer_port", FT_UINT16, BASE_DEC, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_bitcoin_capture_direction,
+      { "Direction", "bitcoin.capture_direction", FT_UINT8, BASE_DEC, VALS(capture_directions), 0x0, NULL, HFILL }
+    },
+    { &hf_bitcoin_capture_time,
+      { "Capture time", "bitcoin.capture_time", FT_ABSOLUTE_TIME, ABSOLUTE_TIME_LOCAL, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_bitcoin_state_evicted,
+      { "Analysis state dropped", "bitcoin.state.evicted", FT_UINT32, BASE_DEC, NULL, 0x0, NULL, HFILL }
+    },
 
     /* version message */
     { &hf_bitcoin_msg_version,
@@ -1351,6 +5896,12 @@ proto_register_bitcoin(void)
     { &hf_msg_version_start_height,
       { "Block start height", "bitcoin.version.start_height", FT_UINT32, BASE_DEC, NULL, 0x0, NULL, HFILL }
     },
+    { &hf_msg_version_relay,
+      { "Relay transactions", "bitcoin.version.relay", FT_BOOLEAN, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_version_negotiated,
+      { "Negotiated version", "bitcoin.version.negotiated", FT_UINT32, BASE_DEC, NULL, 0x0, NULL, HFILL }
+    },
 
     /* addr message */
     { &hf_msg_addr_count8,
@@ -1375,6 +5926,74 @@ proto_register_bitcoin(void)
       { "Address timestamp", "bitcoin.addr.timestamp", FT_ABSOLUTE_TIME, ABSOLUTE_TIME_LOCAL, NULL, 0x0, NULL, HFILL }
     },
 
+    /* addrv2 message */
+    { &hf_msg_addrv2_count8,
+      { "Count", "bitcoin.addrv2.count", FT_UINT8, BASE_DEC, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_addrv2_count16,
+      { "Count", "bitcoin.addrv2.count", FT_UINT16, BASE_DEC, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_addrv2_count32,
+      { "Count", "bitcoin.addrv2.count", FT_UINT32, BASE_DEC, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_addrv2_count64,
+      { "Count", "bitcoin.addrv2.count", FT_UINT64, BASE_DEC, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_bitcoin_msg_addrv2,
+      { "Addrv2 message", "bitcoin.addrv2", FT_NONE, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_addrv2_item,
+      { "Address", "bitcoin.addrv2.item", FT_NONE, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_addrv2_timestamp,
+      { "Timestamp", "bitcoin.addrv2.timestamp", FT_ABSOLUTE_TIME, ABSOLUTE_TIME_LOCAL, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_addrv2_services,
+      { "Node services", "bitcoin.addrv2.services", FT_UINT64, BASE_HEX, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_addrv2_network,
+      { "Network", "bitcoin.addrv2.network", FT_UINT8, BASE_DEC, VALS(addrv2_networks), 0x0, NULL, HFILL }
+    },
+    { &hf_msg_addrv2_addr_length8,
+      { "Address length", "bitcoin.addrv2.addr_length", FT_UINT8, BASE_DEC, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_addrv2_addr_length16,
+      { "Address length", "bitcoin.addrv2.addr_length", FT_UINT16, BASE_DEC, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_addrv2_addr_length32,
+      { "Address length", "bitcoin.addrv2.addr_length", FT_UINT32, BASE_DEC, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_addrv2_addr_length64,
+      { "Address length", "bitcoin.addrv2.addr_length", FT_UINT64, BASE_DEC, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_addrv2_address_ipv4,
+      { "Address", "bitcoin.addrv2.address.ipv4", FT_IPv4, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_addrv2_address_ipv6,
+      { "Address", "bitcoin.addrv2.address.ipv6", FT_IPv6, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_addrv2_address,
+      { "Address", "bitcoin.addrv2.address", FT_BYTES, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_addrv2_port,
+      { "Port", "bitcoin.addrv2.port", FT_UINT16, BASE_DEC, NULL, 0x0, NULL, HFILL }
+    },
+
+    /* gossiped address tracking */
+    { &hf_addr_first_frame,
+      { "First gossiped in frame", "bitcoin.addr.first_frame", FT_FRAMENUM, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_addr_last_frame,
+      { "Last gossiped in frame", "bitcoin.addr.last_frame", FT_FRAMENUM, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_addr_peers,
+      { "Relaying peers", "bitcoin.addr.peers", FT_UINT32, BASE_DEC, NULL, 0x0,
+        "Number of distinct peers that gossiped this address in the capture", HFILL }
+    },
+    { &hf_addr_sightings,
+      { "Times gossiped", "bitcoin.addr.sightings", FT_UINT32, BASE_DEC, NULL, 0x0, NULL, HFILL }
+    },
+
     /* inv message */
     { &hf_msg_inv_count8,
       { "Count", "bitcoin.inv.count", FT_UINT8, BASE_DEC, NULL, 0x0, NULL, HFILL }
@@ -1397,6 +6016,9 @@ proto_register_bitcoin(void)
     { &hf_msg_inv_hash,
       { "Data hash", "bitcoin.inv.hash", FT_BYTES, BASE_NONE, NULL, 0x0, NULL, HFILL }
     },
+    { &hf_msg_inv_object_frame,
+      { "Object in frame", "bitcoin.object.frame", FT_FRAMENUM, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
 
     /* getdata message */
     { &hf_msg_getdata_count8,
@@ -1420,6 +6042,24 @@ proto_register_bitcoin(void)
     { &hf_msg_getdata_hash,
       { "Data hash", "bitcoin.getdata.hash", FT_BYTES, BASE_NONE, NULL, 0x0, NULL, HFILL }
     },
+    { &hf_msg_getdata_answer_frame,
+      { "Answered in frame", "bitcoin.getdata.answer_frame", FT_FRAMENUM, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_getdata_request_frame,
+      { "Requested in frame", "bitcoin.getdata.request_frame", FT_FRAMENUM, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_getdata_response_time,
+      { "Response time", "bitcoin.getdata.response_time", FT_RELATIVE_TIME, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_getdata_notfound,
+      { "Answered with notfound", "bitcoin.getdata.notfound", FT_BOOLEAN, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_getdata_unanswered,
+      { "Not answered", "bitcoin.getdata.unanswered", FT_BOOLEAN, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_getdata_inflight,
+      { "Requests in flight", "bitcoin.getdata.inflight", FT_UINT32, BASE_DEC, NULL, 0x0, NULL, HFILL }
+    },
 
     /* notfound message */
     { &hf_msg_notfound_count8,
@@ -1669,6 +6309,40 @@ proto_register_bitcoin(void)
       { "Stopping hash", "bitcoin.getheaders.hash_stop", FT_BYTES, BASE_NONE, NULL, 0x0, NULL, HFILL }
     },
 
+    /* headers message */
+    { &hf_msg_headers_count8,
+      { "Count", "bitcoin.headers.count", FT_UINT8, BASE_DEC, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_headers_count16,
+      { "Count", "bitcoin.headers.count", FT_UINT16, BASE_DEC, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_headers_count32,
+      { "Count", "bitcoin.headers.count", FT_UINT32, BASE_DEC, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_headers_count64,
+      { "Count", "bitcoin.headers.count", FT_UINT64, BASE_DEC, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_bitcoin_msg_headers,
+      { "Headers message", "bitcoin.headers", FT_NONE, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_headers_header,
+      { "Block header", "bitcoin.headers.header", FT_NONE, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_headers_announcement,
+      { "Block announcement (sendheaders)", "bitcoin.headers.announcement", FT_BOOLEAN, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+
+    /* locator resolved against the header chain */
+    { &hf_msg_locator_fork,
+      { "Fork point", "bitcoin.locator.fork", FT_BYTES, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_locator_fork_height,
+      { "Fork point height", "bitcoin.locator.fork_height", FT_UINT32, BASE_DEC, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_locator_fork_frame,
+      { "Fork point in frame", "bitcoin.locator.fork_frame", FT_FRAMENUM, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+
     /* tx message */
     { &hf_bitcoin_msg_tx,
       { "Tx message", "bitcoin.tx", FT_NONE, BASE_NONE, NULL, 0x0, NULL, HFILL }
@@ -1724,6 +6398,15 @@ proto_register_bitcoin(void)
     { &hf_msg_tx_in_seq,
       { "Sequence", "bitcoin.tx.in.seq", FT_UINT32, BASE_DEC, NULL, 0x0, NULL, HFILL }
     },
+    { &hf_msg_tx_in_prev_frame,
+      { "Output created in frame", "bitcoin.tx.in.prev_output.frame", FT_FRAMENUM, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_tx_in_prev_value,
+      { "Output value", "bitcoin.tx.in.prev_output.value", FT_UINT64, BASE_DEC, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_tx_in_prev_script_type,
+      { "Output script type", "bitcoin.tx.in.prev_output.script_type", FT_UINT8, BASE_DEC, VALS(script_types), 0x0, NULL, HFILL }
+    },
 
     /* tx message - output */
     { &hf_msg_tx_out_count8,
@@ -1759,10 +6442,51 @@ proto_register_bitcoin(void)
     { &hf_msg_tx_out_script,
       { "Script", "bitcoin.tx.out.script", FT_BYTES, BASE_NONE, NULL, 0x0, NULL, HFILL }
     },
+    { &hf_msg_tx_out_script_type,
+      { "Script type", "bitcoin.tx.out.script_type", FT_UINT8, BASE_DEC, VALS(script_types), 0x0, NULL, HFILL }
+    },
 
+    { &hf_msg_tx_flag,
+      { "Marker and flag", "bitcoin.tx.flag", FT_UINT16, BASE_HEX, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_tx_witness,
+      { "Witness", "bitcoin.tx.witness", FT_NONE, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_tx_witness_count,
+      { "Item count", "bitcoin.tx.witness.count", FT_UINT64, BASE_DEC, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_tx_witness_item,
+      { "Item", "bitcoin.tx.witness.item", FT_BYTES, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
     { &hf_msg_tx_lock_time,
       { "Block lock time or block ID", "bitcoin.tx.lock_time", FT_UINT32, BASE_DEC, NULL, 0x0, NULL, HFILL }
     },
+    { &hf_msg_tx_size,
+      { "Transaction size", "bitcoin.tx.size", FT_UINT32, BASE_DEC, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_tx_vsize,
+      { "Virtual size", "bitcoin.tx.vsize", FT_UINT32, BASE_DEC, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_tx_txid,
+      { "Txid", "bitcoin.tx.txid", FT_BYTES, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_tx_wtxid,
+      { "Wtxid", "bitcoin.tx.wtxid", FT_BYTES, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_tx_duplicate_of,
+      { "Duplicate of frame", "bitcoin.tx.duplicate_of", FT_FRAMENUM, BASE_NONE, NULL, 0x0,
+        "Frame in which this transaction was first relayed", HFILL }
+    },
+    { &hf_msg_tx_fee,
+      { "Fee", "bitcoin.tx.fee", FT_UINT64, BASE_DEC, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_tx_feerate,
+      { "Feerate (sat/vB)", "bitcoin.tx.feerate", FT_DOUBLE, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_tx_package_feerate,
+      { "Package feerate (sat/vB)", "bitcoin.tx.package_feerate", FT_DOUBLE, BASE_NONE, NULL, 0x0,
+        "Feerate of the tx together with its ancestors seen in the capture", HFILL }
+    },
 
     /* block message */
     { &hf_msg_block_transactions8,
@@ -1798,6 +6522,134 @@ proto_register_bitcoin(void)
     { &hf_msg_block_nonce,
       { "Nonce", "bitcoin.block.nonce", FT_UINT32, BASE_HEX, NULL, 0x0, NULL, HFILL }
     },
+    { &hf_msg_block_hash,
+      { "Block hash", "bitcoin.block.hash", FT_BYTES, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_block_txs_skipped,
+      { "Transactions not dissected (header-only mode)", "bitcoin.block.txs_skipped", FT_NONE, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_block_height,
+      { "Height", "bitcoin.block.height", FT_UINT32, BASE_DEC, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_block_prev_frame,
+      { "Previous block in frame", "bitcoin.block.prev_frame", FT_FRAMENUM, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_block_orphan,
+      { "Orphan (previous block not seen)", "bitcoin.block.orphan", FT_BOOLEAN, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_block_stale,
+      { "Stale (not on the best chain)", "bitcoin.block.stale", FT_BOOLEAN, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_block_fork,
+      { "Fork", "bitcoin.block.fork", FT_BOOLEAN, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_block_reorg_depth,
+      { "Reorg depth", "bitcoin.block.reorg.depth", FT_UINT32, BASE_DEC, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_block_reorg_fork_frame,
+      { "Reorg fork point in frame", "bitcoin.block.reorg.fork_frame", FT_FRAMENUM, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_block_prop_announce_frame,
+      { "First announced in frame", "bitcoin.block.prop.announce_frame", FT_FRAMENUM, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_block_prop_announce_delay,
+      { "Time since first announcement", "bitcoin.block.prop.announce_delay", FT_RELATIVE_TIME, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_block_prop_first_frame,
+      { "First received in frame", "bitcoin.block.prop.first_frame", FT_FRAMENUM, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_block_prop_first_delay,
+      { "Time since first received", "bitcoin.block.prop.first_delay", FT_RELATIVE_TIME, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_block_prop_peers,
+      { "Received from peers", "bitcoin.block.prop.peers", FT_UINT32, BASE_DEC, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_block_prop_spread,
+      { "Spread across peers", "bitcoin.block.prop.spread", FT_RELATIVE_TIME, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+
+    /* cmpctblock message */
+    { &hf_bitcoin_msg_cmpctblock,
+      { "Cmpctblock message", "bitcoin.cmpctblock", FT_NONE, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_cmpctblock_nonce,
+      { "Nonce", "bitcoin.cmpctblock.nonce", FT_UINT64, BASE_HEX, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_cmpctblock_shortids8,
+      { "Short IDs count", "bitcoin.cmpctblock.shortids_count", FT_UINT8, BASE_DEC, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_cmpctblock_shortids16,
+      { "Short IDs count", "bitcoin.cmpctblock.shortids_count", FT_UINT16, BASE_DEC, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_cmpctblock_shortids32,
+      { "Short IDs count", "bitcoin.cmpctblock.shortids_count", FT_UINT32, BASE_DEC, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_cmpctblock_shortids64,
+      { "Short IDs count", "bitcoin.cmpctblock.shortids_count", FT_UINT64, BASE_DEC, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_cmpctblock_shortid_list,
+      { "Short IDs", "bitcoin.cmpctblock.shortids", FT_BYTES, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_cmpctblock_prefilled8,
+      { "Prefilled txs count", "bitcoin.cmpctblock.prefilled_count", FT_UINT8, BASE_DEC, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_cmpctblock_prefilled16,
+      { "Prefilled txs count", "bitcoin.cmpctblock.prefilled_count", FT_UINT16, BASE_DEC, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_cmpctblock_prefilled32,
+      { "Prefilled txs count", "bitcoin.cmpctblock.prefilled_count", FT_UINT32, BASE_DEC, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_cmpctblock_prefilled64,
+      { "Prefilled txs count", "bitcoin.cmpctblock.prefilled_count", FT_UINT64, BASE_DEC, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_cmpctblock_high_bandwidth,
+      { "High-bandwidth announcement", "bitcoin.cmpctblock.high_bandwidth", FT_BOOLEAN, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+
+    /* feefilter message */
+    { &hf_bitcoin_msg_feefilter,
+      { "Feefilter message", "bitcoin.feefilter", FT_NONE, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_feefilter_feerate,
+      { "Minimum feerate (sat/kvB)", "bitcoin.feefilter.feerate", FT_UINT64, BASE_DEC, NULL, 0x0, NULL, HFILL }
+    },
+
+    /* sendcmpct message */
+    { &hf_bitcoin_msg_sendcmpct,
+      { "Sendcmpct message", "bitcoin.sendcmpct", FT_NONE, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_sendcmpct_announce,
+      { "High-bandwidth mode", "bitcoin.sendcmpct.announce", FT_BOOLEAN, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_sendcmpct_version,
+      { "Version", "bitcoin.sendcmpct.version", FT_UINT64, BASE_DEC, NULL, 0x0, NULL, HFILL }
+    },
+
+    /* feature negotiation */
+    { &hf_bitcoin_negotiation_order,
+      { "Negotiation order", "bitcoin.negotiation.order", FT_UINT8, BASE_DEC, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_bitcoin_negotiation_after_verack,
+      { "Sent after verack", "bitcoin.negotiation.after_verack", FT_BOOLEAN, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_bitcoin_negotiation_sender,
+      { "Negotiated by sender", "bitcoin.negotiation.sender", FT_STRING, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_bitcoin_negotiation_peer,
+      { "Negotiated by peer", "bitcoin.negotiation.peer", FT_STRING, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_block_stream_start,
+      { "Block started in frame", "bitcoin.block.stream.start", FT_FRAMENUM, BASE_NONE, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_block_stream_length,
+      { "Block length", "bitcoin.block.stream.length", FT_UINT32, BASE_DEC, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_block_stream_pending,
+      { "Bytes still to come", "bitcoin.block.stream.pending", FT_UINT32, BASE_DEC, NULL, 0x0, NULL, HFILL }
+    },
+    { &hf_msg_block_stream_txs,
+      { "Transactions dissected", "bitcoin.block.stream.tx_count", FT_UINT32, BASE_DEC, NULL, 0x0, NULL, HFILL }
+    },
 
     /* services */
     { &hf_services_network,
@@ -1829,6 +6681,10 @@ proto_register_bitcoin(void)
     &ett_tx_in_list,
     &ett_tx_in_outp,
     &ett_tx_out_list,
+    &ett_tx_witness,
+    &ett_block_stream,
+    &ett_addrv2,
+    &ett_headers_list,
     &ett_ping,
     &ett_pong,
     &ett_reject,
@@ -1846,13 +6702,103 @@ proto_register_bitcoin(void)
   proto_register_field_array(proto_bitcoin, hf, array_length(hf));
 
   new_register_dissector("bitcoin", dissect_bitcoin, proto_bitcoin);
+  new_register_dissector("bitcoin_capture", dissect_bitcoin_capture_record, proto_bitcoin);
+  new_register_dissector("bitcoin_blockfile", dissect_bitcoin_block_record, proto_bitcoin);
+
+  bitcoin_eo_tap = register_tap("bitcoin_eo"); /* Bitcoin Export Object tap */
+  bitcoin_tap    = register_tap("bitcoin");
+  bitcoin_perf_tap = register_tap("bitcoin_perf");
 
-  bitcoin_module = prefs_register_protocol(proto_bitcoin, NULL);
+  register_init_routine(bitcoin_init);
+
+  bitcoin_module = prefs_register_protocol(proto_bitcoin, proto_reg_handoff_bitcoin);
   prefs_register_bool_preference(bitcoin_module, "desegment",
                                  "Desegment all Bitcoin messages spanning multiple TCP segments",
                                  "Whether the Bitcoin dissector should desegment all messages"
                                  " spanning multiple TCP segments",
                                  &bitcoin_desegment);
+  prefs_register_bool_preference(bitcoin_module, "stream_blocks",
+                                 "Dissect block messages incrementally",
+                                 "Whether block messages should be dissected segment by segment as"
+                                 " they arrive instead of being reassembled first",
+                                 &bitcoin_stream_blocks);
+
+  prefs_register_bool_preference(bitcoin_module, "block_header_only",
+                                 "Dissect only the header of block messages",
+                                 "Whether block messages should be dissected up to the transaction"
+                                 " count only, skipping all transactions (which then aren't indexed"
+                                 " either)",
+                                 &bitcoin_block_header_only);
+
+  prefs_register_bool_preference(bitcoin_module, "outpoint_index",
+                                 "Link tx inputs to the outputs they spend",
+                                 "Whether to index every tx output in the capture so inputs can be"
+                                 " linked to the frame and value of the output they spend",
+                                 &bitcoin_outpoint_index);
+  prefs_register_bool_preference(bitcoin_module, "addr_tracking",
+                                 "Track gossiped addresses",
+                                 "Whether addresses from addr and addrv2 messages should be collected"
+                                 " into a capture-wide table of networks, relaying peers and services",
+                                 &bitcoin_addr_tracking);
+  prefs_register_bool_preference(bitcoin_module, "track_duplicates",
+                                 "Detect duplicate tx relay",
+                                 "Whether each relayed tx should be checked against the txs already"
+                                 " seen in the capture",
+                                 &bitcoin_track_duplicates);
+  prefs_register_bool_preference(bitcoin_module, "header_chain",
+                                 "Reconstruct the header chain",
+                                 "Whether block and headers messages should be linked into a"
+                                 " capture-wide header chain, giving block heights and flagging"
+                                 " stale blocks, forks and reorgs",
+                                 &bitcoin_header_chain);
+  prefs_register_bool_preference(bitcoin_module, "block_propagation",
+                                 "Track block propagation",
+                                 "Whether to record when each block was first announced and first"
+                                 " received from each peer, for the block propagation statistic",
+                                 &bitcoin_block_propagation);
+  prefs_register_bool_preference(bitcoin_module, "track_getdata",
+                                 "Track getdata requests",
+                                 "Whether inventory requested through getdata should be matched with"
+                                 " the tx, block, cmpctblock or notfound message answering it",
+                                 &bitcoin_track_getdata);
+  prefs_register_bool_preference(bitcoin_module, "object_index",
+                                 "Index txs and blocks by hash",
+                                 "Whether inventory entries (inv, getdata, notfound) should link to"
+                                 " the first frame carrying the tx or block they name",
+                                 &bitcoin_object_index);
+  prefs_register_bool_preference(bitcoin_module, "cache_digests",
+                                 "Cache txids and block hashes",
+                                 "Whether hashes computed for a frame should be kept for when it is"
+                                 " dissected again, trading about 80 bytes per tx for not"
+                                 " rehashing blocks on every redisplay",
+                                 &bitcoin_cache_digests);
+  prefs_register_uint_preference(bitcoin_module, "getdata_timeout",
+                                 "Getdata stall timeout (ms)",
+                                 "Requests not answered within this time are reported as stalled",
+                                 10, &bitcoin_getdata_timeout);
+  prefs_register_uint_preference(bitcoin_module, "max_payload",
+                                 "Maximum payload length",
+                                 "Messages claiming a longer payload are flagged and not reassembled"
+                                 " (0 for no limit)",
+                                 10, &bitcoin_max_payload);
+  prefs_register_uint_preference(bitcoin_module, "outpoint_index_size",
+                                 "Outpoint index memory budget (MB)",
+                                 "Maximum memory used by the outpoint index; outputs seen once it"
+                                 " is full are not indexed",
+                                 10, &bitcoin_outpoint_index_size);
+
+  prefs_register_uint_preference(bitcoin_module, "state_budget",
+                                 "Analysis state memory budget per table (MB)",
+                                 "Maximum memory of each table of the capture-wide analyses (header"
+                                 " chain, relay, address, propagation, getdata and object tracking);"
+                                 " the oldest entries are dropped first, 0 for no limit",
+                                 10, &bitcoin_state_budget);
+
+  range_convert_str(&global_bitcoin_tcp_range, BITCOIN_TCP_PORTS, 65535);
+  prefs_register_range_preference(bitcoin_module, "tcp.ports", "Bitcoin TCP ports",
+                                  "TCP ports to be decoded as Bitcoin without going through"
+                                  " the heuristic (default " BITCOIN_TCP_PORTS ")",
+                                  &global_bitcoin_tcp_range, 65535);
 
 }
 
@@ -1864,10 +6810,38 @@ proto_register_bitcoin(void)
 void
 proto_reg_handoff_bitcoin(void)
 {
-  bitcoin_handle = find_dissector("bitcoin");
-  dissector_add_handle("tcp.port", bitcoin_handle);  /* for 'decode-as' */
+  static gboolean initialized = FALSE;
+
+  if (!initialized)
+  {
+    bitcoin_handle = find_dissector("bitcoin");
+    dissector_add_handle("tcp.port", bitcoin_handle);  /* for 'decode-as' */
+
+    heur_dissector_add( "tcp", dissect_bitcoin_heur, proto_bitcoin);
+
+    stats_tree_register("bitcoin", "bitcoin_feerate", "Bitcoin/Feerate", 0,
+                        bitcoin_feerate_stats_tree_packet, bitcoin_feerate_stats_tree_init, NULL);
+    stats_tree_register("bitcoin", "bitcoin_txrelay", "Bitcoin/Tx relay", 0,
+                        bitcoin_relay_stats_tree_packet, bitcoin_relay_stats_tree_init, NULL);
+    stats_tree_register("bitcoin", "bitcoin_addr", "Bitcoin/Addr relay", 0,
+                        bitcoin_addr_stats_tree_packet, bitcoin_addr_stats_tree_init, NULL);
+    stats_tree_register("bitcoin", "bitcoin_blockprop", "Bitcoin/Block propagation", 0,
+                        bitcoin_blockprop_stats_tree_packet, bitcoin_blockprop_stats_tree_init, NULL);
+    stats_tree_register("bitcoin_perf", "bitcoin_perf", "Bitcoin/Dissection time", 0,
+                        bitcoin_perf_stats_tree_packet, bitcoin_perf_stats_tree_init, NULL);
+    stats_tree_register("bitcoin", "bitcoin_state", "Bitcoin/Analysis state", 0,
+                        bitcoin_state_stats_tree_packet, bitcoin_state_stats_tree_init, NULL);
+    initialized = TRUE;
+  }
+  else
+  {
+    dissector_delete_uint_range("tcp.port", bitcoin_tcp_range, bitcoin_handle);
+    g_free(bitcoin_tcp_range);
+  }
 
-  heur_dissector_add( "tcp", dissect_bitcoin_heur, proto_bitcoin);
+  /* known ports are dispatched directly, the heuristic only sees the rest */
+  bitcoin_tcp_range = range_copy(global_bitcoin_tcp_range);
+  dissector_add_uint_range("tcp.port", bitcoin_tcp_range, bitcoin_handle);
 }
 
 /*
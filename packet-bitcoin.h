@@ -0,0 +1,36 @@
+/* packet-bitcoin.h
+ * Definitions for bitcoin dissection
+ *
+ * $Id$
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __PACKET_BITCOIN_H__
+#define __PACKET_BITCOIN_H__
+
+/* Used for Bitcoin Export Object feature ("bitcoin_eo" tap) */
+typedef struct _bitcoin_eo_t {
+  const gchar  *command;        /* "block" or "tx" */
+  gchar        *hash;           /* block hash or txid, in byte-reversed hex */
+  guint32       payload_len;
+  const guint8 *payload_data;   /* raw serialized payload as found on the wire */
+} bitcoin_eo_t;
+
+#endif /* __PACKET_BITCOIN_H__ */